@@ -0,0 +1,352 @@
+#include "frame_capture.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+namespace giv {
+namespace io {
+
+namespace {
+
+// frames waiting for the writer before capture() blocks, bounds memory when
+// the disk or the encoder cannot keep up
+constexpr size_t maxPendingFrames = 8;
+
+bool endsWith(std::string const &s, std::string const &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// splits pattern around its only %d / %0<width>d, %% stands for a literal %
+bool splitFramePattern(std::string const &pattern, std::string &head,
+                       std::string &tail, int &width, char &fill) {
+  bool found = false;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    std::string &text = found ? tail : head;
+    if (pattern[i] != '%') {
+      text += pattern[i];
+      continue;
+    }
+    if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+      text += '%';
+      ++i;
+      continue;
+    }
+    if (found)
+      return false;
+
+    size_t j = i + 1;
+    fill = ' ';
+    if (j < pattern.size() && pattern[j] == '0') {
+      fill = '0';
+      ++j;
+    }
+    width = 0;
+    while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9' &&
+           width < 100) {
+      width = width * 10 + (pattern[j++] - '0');
+    }
+    if (j >= pattern.size() || pattern[j] != 'd')
+      return false;
+    found = true;
+    i = j;
+  }
+  return found;
+}
+
+} // namespace
+
+FrameCapture::FrameCapture(std::string output, int framesPerSecond,
+                           size_t ringSize)
+    : m_output(std::move(output)), m_usePPM(endsWith(m_output, ".ppm")),
+      m_framesPerSecond(framesPerSecond), m_slots(std::max<size_t>(2, ringSize)) {
+  if (m_usePPM) {
+    m_validPattern = splitFramePattern(m_output, m_pathHead, m_pathTail,
+                                       m_pathWidth, m_pathFill);
+    if (!m_validPattern) {
+      std::cerr << "Capture pattern " << m_output
+                << " needs exactly one %d for the frame number\n";
+    }
+  }
+  m_writer = std::thread([this] { writerLoop(); });
+}
+
+FrameCapture::~FrameCapture() {
+  finish();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  m_writer.join();
+  releaseSlots();
+}
+
+void FrameCapture::capture(GLuint framebuffer) {
+  PROFILE_ZONE("frame capture");
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  if (viewport[2] <= 0 || viewport[3] <= 0)
+    return;
+  if (viewport[2] != m_width || viewport[3] != m_height) {
+    resize(viewport[2], viewport[3]);
+  }
+
+  // the oldest slot is reused, its readback was issued ringSize frames ago
+  Slot &slot = m_slots[m_next];
+  m_next = (m_next + 1) % m_slots.size();
+  collect(slot);
+
+  GLint previousFramebuffer;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(viewport[0], viewport[1], m_width, m_height, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.width = m_width;
+  slot.height = m_height;
+  slot.number = m_captured++;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+}
+
+void FrameCapture::finish() {
+  // oldest first so frames reach the writer in order
+  for (size_t i = 0; i < m_slots.size(); ++i) {
+    collect(m_slots[(m_next + i) % m_slots.size()]);
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_wake.wait(lock, [this] { return m_pending.empty(); });
+}
+
+std::string const &FrameCapture::output() const { return m_output; }
+
+size_t FrameCapture::framesCaptured() const { return m_captured; }
+
+size_t FrameCapture::framesDropped() const { return m_dropped; }
+
+//
+// readback
+//
+void FrameCapture::resize(int width, int height) {
+  finish();
+  releaseSlots();
+
+  m_width = width;
+  m_height = height;
+  GLsizeiptr bytes = GLsizeiptr(width) * height * 4;
+  for (Slot &slot : m_slots) {
+    glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_next = 0;
+}
+
+void FrameCapture::collect(Slot &slot) {
+  if (!slot.fence)
+    return;
+
+  // normally signalled long ago, this only blocks when the GPU is a whole
+  // ring of frames behind
+  GLenum status = GL_TIMEOUT_EXPIRED;
+  while (status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              GLuint64(1000000000));
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+  if (status == GL_WAIT_FAILED) {
+    ++m_dropped;
+    return;
+  }
+
+  size_t bytes = size_t(slot.width) * slot.height * 4;
+  Frame frame{{}, slot.width, slot.height, slot.number};
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.wait(lock, [this] { return m_pending.size() < maxPendingFrames; });
+    if (!m_spare.empty()) {
+      frame.pixels = std::move(m_spare.back());
+      m_spare.pop_back();
+    }
+  }
+  frame.pixels.resize(bytes);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  void const *mapped =
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+  if (mapped) {
+    std::memcpy(frame.pixels.data(), mapped, bytes);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (!mapped) {
+    ++m_dropped;
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.push_back(std::move(frame));
+  }
+  m_wake.notify_all();
+}
+
+void FrameCapture::releaseSlots() {
+  for (Slot &slot : m_slots) {
+    if (slot.fence) {
+      glDeleteSync(slot.fence);
+    }
+    if (slot.buffer) {
+      glDeleteBuffers(1, &slot.buffer);
+    }
+    slot = Slot{};
+  }
+}
+
+//
+// writer thread
+//
+void FrameCapture::writerLoop() {
+  profiler::setThreadName("frame capture");
+
+#ifndef _WIN32
+  // a missing ffmpeg, or one that exits early, turns the next write into
+  // EPIPE instead of a SIGPIPE that ends the app. Every pipe write, flush and
+  // close happens on this thread.
+  sigset_t pipeSignal;
+  sigemptyset(&pipeSignal);
+  sigaddset(&pipeSignal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+#endif
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_wake.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+    if (m_pending.empty())
+      break;
+
+    Frame frame = std::move(m_pending.front());
+    lock.unlock();
+    bool written;
+    {
+      PROFILE_ZONE("write frame");
+      written = write(frame);
+    }
+    if (!written) {
+      ++m_dropped;
+    }
+    lock.lock();
+
+    // only popped once written so finish() also waits for the write
+    m_pending.pop_front();
+    m_spare.push_back(std::move(frame.pixels));
+    m_wake.notify_all();
+  }
+  lock.unlock();
+
+  if (m_ffmpeg) {
+    pclose(m_ffmpeg);
+    m_ffmpeg = nullptr;
+  }
+}
+
+bool FrameCapture::write(Frame const &frame) {
+  return m_usePPM ? writeImage(frame) : writeVideo(frame);
+}
+
+bool FrameCapture::writeImage(Frame const &frame) {
+  if (!m_validPattern)
+    return false;
+
+  std::string number = std::to_string(frame.number);
+  std::string path = m_pathHead;
+  if (int(number.size()) < m_pathWidth) {
+    path.append(size_t(m_pathWidth) - number.size(), m_pathFill);
+  }
+  path += number;
+  path += m_pathTail;
+
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    std::cerr << "Unable to write " << path << '\n';
+    return false;
+  }
+
+  size_t rowBytes = size_t(frame.width) * 4;
+  std::fprintf(file, "P6\n%d %d\n255\n", frame.width, frame.height);
+  std::vector<unsigned char> row(size_t(frame.width) * 3);
+  // GL rows start at the bottom, PPM rows at the top
+  for (int y = frame.height - 1; y >= 0; --y) {
+    unsigned char const *rgba = frame.pixels.data() + y * rowBytes;
+    for (int x = 0; x < frame.width; ++x) {
+      row[x * 3 + 0] = rgba[x * 4 + 0];
+      row[x * 3 + 1] = rgba[x * 4 + 1];
+      row[x * 3 + 2] = rgba[x * 4 + 2];
+    }
+    std::fwrite(row.data(), 1, row.size(), file);
+  }
+  return std::fclose(file) == 0;
+}
+
+bool FrameCapture::writeVideo(Frame const &frame) {
+  if (m_ffmpegClosed)
+    return false;
+
+  if (!m_ffmpeg) {
+    // even dimensions for yuv420p, ffmpeg flips the bottom-up rows
+    std::string command =
+        "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgba -s " +
+        std::to_string(frame.width) + 'x' + std::to_string(frame.height) +
+        " -r " + std::to_string(m_framesPerSecond) +
+        " -i - -vf \"vflip,scale=trunc(iw/2)*2:trunc(ih/2)*2\""
+        " -pix_fmt yuv420p \"" +
+        m_output + '"';
+    m_ffmpeg = popen(command.c_str(), "w");
+    if (!m_ffmpeg) {
+      std::cerr << "Unable to start ffmpeg for " << m_output << '\n';
+      return false;
+    }
+    m_streamWidth = frame.width;
+    m_streamHeight = frame.height;
+  }
+
+  // a video stream has a single size
+  if (frame.width != m_streamWidth || frame.height != m_streamHeight)
+    return false;
+  bool written = std::fwrite(frame.pixels.data(), 1, frame.pixels.size(),
+                             m_ffmpeg) == frame.pixels.size() &&
+                 std::fflush(m_ffmpeg) == 0;
+  if (!written) {
+    // ffmpeg is gone (not installed, or it rejected the output), the rest of
+    // the recording is dropped rather than retried
+    int status = pclose(m_ffmpeg);
+    m_ffmpeg = nullptr;
+    m_ffmpegClosed = true;
+    std::cerr << "ffmpeg stopped reading frames for " << m_output
+              << " (exit status " << status << ")\n";
+  }
+  return written;
+}
+
+} // namespace io
+} // namespace giv
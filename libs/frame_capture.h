@@ -0,0 +1,111 @@
+#pragma once
+
+// Asynchronous frame capture.
+//
+// capture() queues a glReadPixels of the current frame into one of a ring of
+// pixel pack buffers and returns straight away. The buffer is only mapped
+// once its fence has signalled, ringSize - 1 frames later, so the CPU never
+// waits on the GPU for the readback. Mapped frames are copied into a
+// recycled buffer and handed to a writer thread which either writes a PPM
+// image sequence or pipes raw RGBA frames into ffmpeg.
+//
+//   FrameCapture capture("frames/ride_%05d.ppm");     // image sequence
+//   FrameCapture capture("ride.mp4", 60);             // through ffmpeg
+//   ...
+//   draw(...);
+//   capture.capture(framebuffer);  // before the buffers are swapped
+
+#include "glad/glad.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace giv {
+namespace io {
+
+class FrameCapture {
+public:
+  // outputs ending in .ppm hold one %d (or %05d, ...) for the frame number,
+  // anything else is passed to ffmpeg as the output file
+  explicit FrameCapture(std::string output, int framesPerSecond = 60,
+                        size_t ringSize = 3);
+  ~FrameCapture();
+
+  FrameCapture(FrameCapture const &) = delete;
+  FrameCapture &operator=(FrameCapture const &) = delete;
+
+  // reads the current viewport of framebuffer (0 for the back buffer)
+  void capture(GLuint framebuffer);
+
+  // maps every outstanding readback and waits for the writer to finish
+  void finish();
+
+  std::string const &output() const;
+  size_t framesCaptured() const;
+  size_t framesDropped() const;
+
+private:
+  struct Slot {
+    GLuint buffer = 0;
+    GLsync fence = nullptr;
+    int width = 0;
+    int height = 0;
+    size_t number = 0;
+  };
+
+  struct Frame {
+    std::vector<unsigned char> pixels; // RGBA, bottom row first
+    int width;
+    int height;
+    size_t number;
+  };
+
+  void resize(int width, int height);
+  void collect(Slot &slot);
+  void releaseSlots();
+
+  void writerLoop();
+  bool write(Frame const &frame);
+  bool writeImage(Frame const &frame);
+  bool writeVideo(Frame const &frame);
+
+  std::string m_output;
+  bool m_usePPM;
+  // m_output split around its frame number conversion, never used as a
+  // printf format itself
+  bool m_validPattern = false;
+  std::string m_pathHead;
+  std::string m_pathTail;
+  int m_pathWidth = 0;
+  char m_pathFill = ' ';
+  int m_framesPerSecond;
+
+  std::vector<Slot> m_slots;
+  size_t m_next = 0;
+  size_t m_captured = 0;
+  std::atomic<size_t> m_dropped{0};
+  int m_width = 0;
+  int m_height = 0;
+
+  // writer thread
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<Frame> m_pending;
+  std::vector<std::vector<unsigned char>> m_spare; // recycled pixel buffers
+  bool m_stop = false;
+  std::FILE *m_ffmpeg = nullptr;
+  bool m_ffmpegClosed = false; // ffmpeg exited, the rest are dropped
+  int m_streamWidth = 0;
+  int m_streamHeight = 0;
+  std::thread m_writer;
+};
+
+} // namespace io
+} // namespace giv
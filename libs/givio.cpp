@@ -413,19 +413,67 @@ void ImGuiWindow::scrollWheelEvent(ScrollWheelEvent event) {
 // pre/post render functions
 //
 
+bool shouldClose(Window const &window) {
+  return glfwWindowShouldClose(window.handle());
+}
+
+// GPU times lag a few frames behind
+void recordFrameCounters() {
+  auto &stats = givr::renderStats();
+  PROFILE_COUNTER("render", "draw calls", stats.drawCalls);
+  PROFILE_COUNTER("render", "instances", stats.instances);
+  PROFILE_COUNTER("render", "bytes uploaded", stats.bytesUploaded);
+  PROFILE_COUNTER("render", "state changes", stats.stateChanges);
+  PROFILE_COUNTER("render", "state changes elided", stats.stateChangesElided);
+  PROFILE_COUNTER("render", "merged draws", stats.mergedDraws);
+  stats = {};
+  // ImGui and the window code touch GL directly between frames
+  givr::glState().invalidate();
+
+  // deletes what earlier frames released, after the GPU is done with them
+  auto &resources = givr::glResources();
+  resources.collect();
+  for (std::size_t kind = 0; kind < givr::kGLResourceKinds; ++kind) {
+    auto live = resources.live(givr::GLResourceKind(kind));
+    auto name = givr::glResourceKindName(givr::GLResourceKind(kind));
+    PROFILE_COUNTER("GPU resources", name, live.count);
+    PROFILE_COUNTER("GPU KiB", name, live.bytes / 1024.0);
+  }
+  PROFILE_COUNTER("GPU resources", "pending deletion", resources.pending());
+
+  for (auto const &sample : givr::GpuTimers::instance().lastFrame()) {
+    PROFILE_COUNTER("GPU ms", sample.name, sample.milliseconds);
+  }
+}
+
 void preRender(Window const &window) {}
 
-void preRender(ImGuiWindow const &window) { panel::updateMenu(); }
+void preRender(ImGuiWindow const &window) {
+  PROFILE_ZONE("panel");
+  panel::updateMenu();
+}
 
 void postRender(Window const &window) {
+  PROFILE_ZONE("postRender");
+  givr::GpuTimers::instance().endFrame();
+  recordFrameCounters();
   glfwPollEvents();
+  PROFILE_ZONE("swap buffers");
   glfwSwapBuffers(window.handle());
 }
 
 void postRender(ImGuiWindow const &window) {
-  ImGui::Render();
-  glfwPollEvents();
-  giv::io::ImGuiRenderDrawData();
+  PROFILE_ZONE("postRender");
+  {
+    PROFILE_ZONE("ImGui render");
+    ImGui::Render();
+    glfwPollEvents();
+    givr::GpuTimerScope gpuTimer("ImGui");
+    giv::io::ImGuiRenderDrawData();
+  }
+  givr::GpuTimers::instance().endFrame();
+  recordFrameCounters();
+  PROFILE_ZONE("swap buffers");
   glfwSwapBuffers(window.handle());
 }
 
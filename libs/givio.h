@@ -10,6 +10,7 @@
 #include "imgui/imgui_impl_opengl3.h"
 
 // io
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -21,6 +22,7 @@
 
 #include "command_map.h"
 #include "panel.h"
+#include "profiler.h"
 
 namespace giv {
 namespace io {
@@ -251,21 +253,30 @@ private: // functions
 
 std::string glfwVersionString();
 
+bool shouldClose(Window const &window);
+
 void preRender(Window const &);
 void preRender(ImGuiWindow const &);
 
 void postRender(Window const &window);
 void postRender(ImGuiWindow const &window);
 
+// draw call, upload and GPU timer counters for the profiler, once per frame
+void recordFrameCounters();
+
 template <typename Window_t, typename Func>
 void mainloop(Window_t &&window, Func function) {
-  auto previous_time = glfwGetTime();
-  while (!glfwWindowShouldClose(window.handle())) {
-
-    auto current_time = glfwGetTime();
-    auto delta_t = current_time - previous_time;
+  // steady_clock rather than glfwGetTime, headless windows run without GLFW
+  using clock = std::chrono::steady_clock;
+  auto previous_time = clock::now();
+  while (!shouldClose(window)) {
+
+    auto current_time = clock::now();
+    auto delta_t = std::chrono::duration<double>(current_time - previous_time)
+                       .count();
     previous_time = current_time;
 
+    PROFILE_FRAME();
     preRender(window);
 
     function(float(delta_t));
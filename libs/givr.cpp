@@ -242,17 +242,39 @@ void OrthographicProjection::updateAspectRatio(int width, int height) {
 
 using namespace givr::style;
 
-std::string givr::style::phongVertexSource(std::string modelSource, bool usingTexture, bool hasNormals, bool hasColours) {
+std::string givr::style::phongVertexSource(std::string modelSource, bool usingTexture, bool hasNormals, bool hasColours, bool compactVertices, bool geometryStage) {
     return
         "#version 330 core\n" +
         std::string(usingTexture ? "#define USING_TEXTURE\n" : "") +
         std::string(hasNormals ? "#define HAS_NORMALS\n" : "") +
         std::string(hasColours ? "#define HAS_COLOURS\n" : "") +
+        std::string(compactVertices ? "#define COMPACT_VERTICES\n" : "") +
+        std::string(geometryStage ? "#define GEOMETRY_STAGE\n" : "") +
         modelSource +
         std::string(R"shader( mat4 model;
         layout(location=4) in vec3 position;
+        #ifdef COMPACT_VERTICES
+            // see givr::VertexFormat
+            uniform vec3 positionOffset;
+            uniform vec3 positionScale;
+            vec3 decodePosition(vec3 p) { return positionOffset + positionScale * p; }
+            vec3 decodeNormal(vec2 e) {
+                vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+                if (n.z < 0.0) {
+                    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+                }
+                return normalize(n);
+            }
+        #else
+            vec3 decodePosition(vec3 p) { return p; }
+            vec3 decodeNormal(vec3 n) { return n; }
+        #endif
         #ifdef HAS_NORMALS
-            layout(location=5) in vec3 normal;
+            #ifdef COMPACT_VERTICES
+                layout(location=5) in vec2 normal;
+            #else
+                layout(location=5) in vec3 normal;
+            #endif
         #endif
         #ifdef USING_TEXTURE
             layout(location=6) in vec2 uvs;
@@ -264,36 +286,59 @@ std::string givr::style::phongVertexSource(std::string modelSource, bool usingTe
         uniform mat4 view;
         uniform mat4 projection;
 
+        #ifdef GEOMETRY_STAGE
+            // passed on by the geometry shader (see phongGeometrySource)
+            #define fragNormal geomNormal
+            #define originalPosition geomOriginalPosition
+            #define fragUv geomUv
+            #define fragColour geomColour
+        #else
+            // filled at load time for ShowWireFrame (see preparePhongGeometry),
+            // only read when the buffers carry it
+            layout(location=8) in vec3 barycentric;
+            out vec3 fragBarycentricCoords;
+        #endif
         #ifdef HAS_NORMALS
-            out vec3 geomNormal;
+            out vec3 fragNormal;
         #endif
-        out vec3 geomOriginalPosition;
+        out vec3 originalPosition;
         #ifdef USING_TEXTURE
-            out vec2 geomUv;
+            out vec2 fragUv;
         #endif
         #ifdef HAS_COLOURS
-            out vec3 geomColour;
+            out vec3 fragColour;
         #endif
 
         void main(){
+            #ifdef POSE_MODEL
+                model = poseModel();
+            #endif
             mat4 mv = view * model;
             mat4 mvp = projection * mv;
-            gl_Position = mvp * vec4(position, 1.0);
-            geomOriginalPosition = vec3(model * vec4(position, 1.0));
+            vec3 objectPosition = decodePosition(position);
+            gl_Position = mvp * vec4(objectPosition, 1.0);
+            originalPosition = vec3(model * vec4(objectPosition, 1.0));
             #ifdef HAS_NORMALS
-                geomNormal = vec3(model*vec4(normal, 0));
+                fragNormal = vec3(model*vec4(decodeNormal(normal), 0));
             #endif
             #ifdef HAS_COLOURS
-                geomColour = colour;
+                fragColour = colour;
             #endif
             #ifdef USING_TEXTURE
-                geomUv = uvs;
+                fragUv = uvs;
+            #endif
+            #ifndef GEOMETRY_STAGE
+                fragBarycentricCoords = barycentric;
             #endif
         }
 
         )shader"
     );
 }
+
+// flat normals are taken from the world space positions, so they match the
+// ones preparePhongGeometry builds and the smooth ones of geometry that has
+// them
 std::string givr::style::phongGeometrySource(bool usingTexture, bool hasNormals, bool hasColours) {
     return
         "#version 330 core\n" +
@@ -319,31 +364,27 @@ std::string givr::style::phongGeometrySource(bool usingTexture, bool hasNormals,
 
         out vec3 fragNormal;
         out vec3 originalPosition;
-        out vec2 fragUv;
+        #ifdef USING_TEXTURE
+            out vec2 fragUv;
+        #endif
         #ifdef HAS_COLOURS
             out vec3 fragColour;
         #endif
         out vec3 fragBarycentricCoords;
 
         void main() {
-            vec3 normal;
-            if (generateNormals) {
-                normal =
-                    cross(
-                        vec3(gl_in[1].gl_Position - gl_in[0].gl_Position),
-                        vec3(gl_in[2].gl_Position - gl_in[0].gl_Position)
-                    );
-            }
+            vec3 normal = cross(
+                geomOriginalPosition[1] - geomOriginalPosition[0],
+                geomOriginalPosition[2] - geomOriginalPosition[0]);
 
             for(int i = 0; i < 3; i++) {
                 gl_Position = gl_in[i].gl_Position;
-                if (!generateNormals) {
-                    #ifdef HAS_NORMALS
+                fragNormal = normal;
+                #ifdef HAS_NORMALS
+                    if (!generateNormals) {
                         fragNormal = geomNormal[i];
-                    #endif
-                } else {
-                    fragNormal = normal;
-                }
+                    }
+                #endif
                 originalPosition = geomOriginalPosition[i];
                 #ifdef USING_TEXTURE
                     fragUv = geomUv[i];
@@ -924,8 +965,15 @@ namespace geometry {
 
     }
 
+    // parsed once per file content, see AssetRegistry
     MeshGeometry::Data generateGeometry(const MeshGeometry& m) {
-        return loadMeshFile(m.value<Filename>().value().c_str());
+        auto asset = AssetRegistry::instance().mesh(m.filename());
+        if (!asset) {
+            return loadMeshFile(m.filename().c_str());
+        }
+        auto data = asset->data;
+        data.assetKey = asset->key;
+        return data;
     }
 
 }// namespace geometry
@@ -1037,15 +1085,41 @@ LineGeometry::Data givr::geometry::generateGeometry(LineGeometry const &l) {
 //------------------------------------------------------------------------------
 #include <glm/gtc/type_ptr.hpp>
 
+#include <unordered_map>
+
 using Program = givr::Program;
 using vec2f = givr::vec2f;
 using vec3f = givr::vec3f;
 using mat4f = givr::mat4f;
 
+namespace {
+
+// numbered in order of first use, so a program rebuilt from the same
+// sources keeps its place in the RenderQueue's order
+std::uint16_t programVariant(std::uint64_t sources) {
+    static std::unordered_map<std::uint64_t, std::uint16_t> variants;
+    auto id = std::uint16_t(variants.size() + 1);
+    return variants.emplace(sources, id).first->second;
+}
+
+std::uint16_t unnamedProgramVariant() {
+    static std::uint64_t unnamed = 0;
+    // bit 63 keeps these apart from the source hashes' combinations below
+    return programVariant(std::uint64_t(1) << 63 | unnamed++);
+}
+
+std::uint64_t combineSources(std::uint64_t seed, std::uint64_t shader) {
+    return (seed ^ shader) * 0x100000001b3ull & ~(std::uint64_t(1) << 63);
+}
+
+} // namespace
+
 Program::Program(
     GLuint vertex,
     GLuint fragment
-) : m_programID{glCreateProgram()}
+) : m_programID{glCreateProgram()},
+    m_handle{glResources().create(givr::GLResourceKind::Program, m_programID)},
+    m_variant{unnamedProgramVariant()}
 {
     glAttachShader(m_programID, vertex);
     glAttachShader(m_programID, fragment);
@@ -1056,7 +1130,9 @@ Program::Program(
     GLuint vertex,
     GLuint geometry,
     GLuint fragment
-) : m_programID{glCreateProgram()}
+) : m_programID{glCreateProgram()},
+    m_handle{glResources().create(givr::GLResourceKind::Program, m_programID)},
+    m_variant{unnamedProgramVariant()}
 {
     glAttachShader(m_programID, vertex);
     glAttachShader(m_programID, geometry);
@@ -1064,6 +1140,29 @@ Program::Program(
     linkAndErrorCheck();
 }
 
+Program::Program(
+    givr::Shader const &vertex,
+    givr::Shader const &fragment
+) : Program(GLuint(vertex), GLuint(fragment))
+{
+    m_variant = programVariant(combineSources(
+        combineSources(0xcbf29ce484222325ull, vertex.sourceHash()),
+        fragment.sourceHash()));
+}
+
+Program::Program(
+    givr::Shader const &vertex,
+    givr::Shader const &geometry,
+    givr::Shader const &fragment
+) : Program(GLuint(vertex), GLuint(geometry), GLuint(fragment))
+{
+    m_variant = programVariant(combineSources(
+        combineSources(
+            combineSources(0xcbf29ce484222325ull, vertex.sourceHash()),
+            geometry.sourceHash()),
+        fragment.sourceHash()));
+}
+
 void Program::linkAndErrorCheck() {
 
     glLinkProgram(m_programID);
@@ -1079,12 +1178,26 @@ void Program::linkAndErrorCheck() {
     }
 }
 
+Program::Program(Program &&other)
+  : m_programID{std::exchange(other.m_programID, 0)},
+    m_handle{std::exchange(other.m_handle, givr::GLHandle{})},
+    m_variant{other.m_variant}
+{
+}
+
+Program &Program::operator=(Program &&rhs) {
+    std::swap(m_programID, rhs.m_programID);
+    std::swap(m_handle, rhs.m_handle);
+    std::swap(m_variant, rhs.m_variant);
+    return *this;
+}
+
 Program::~Program() {
-    glDeleteProgram(m_programID);
+    glResources().release(m_handle);
 }
 
 void Program::use() {
-    glUseProgram(m_programID);
+    glState().useProgram(m_programID);
 }
 
 void Program::setVec2(const std::string &name, vec2f const &value) const
@@ -1160,8 +1273,12 @@ using Shader = givr::Shader;
 Shader::Shader(
     const std::string &source,
     GLenum shaderType
-) : m_shaderID{glCreateShader(shaderType)}
+) : m_shaderID{glCreateShader(shaderType)},
+    m_sourceHash{0xcbf29ce484222325ull ^ shaderType}
 {
+    for (unsigned char byte : source) {
+        m_sourceHash = (m_sourceHash ^ byte) * 0x100000001b3ull;
+    }
     const GLchar *source_char = source.c_str();
     glShaderSource(m_shaderID, 1, &source_char, NULL);
     glCompileShader(m_shaderID);
@@ -1203,17 +1320,33 @@ Texture::~Texture() {
     dealloc();
 }
 
+Texture::Texture(const Texture &other)
+  : m_textureID{other.m_textureID},
+    m_handle{other.m_handle}
+{
+    glResources().retain(m_handle);
+}
+
+Texture &Texture::operator=(const Texture &rhs) {
+    glResources().retain(rhs.m_handle);
+    dealloc();
+    m_textureID = rhs.m_textureID;
+    m_handle = rhs.m_handle;
+    return *this;
+}
+
 void Texture::alloc()
 {
     dealloc();
     glGenTextures(1, &m_textureID);
+    m_handle = glResources().create(givr::GLResourceKind::Texture, m_textureID);
 }
 void Texture::dealloc()
 {
-    if (m_textureID) {
-        //Temporarily disabled until better way to manage IDs is decided on
-        //glDeleteBuffers(1, &m_textureID);
-    }
+    // deleted with the last copy
+    glResources().release(m_handle);
+    m_textureID = 0;
+    m_handle = {};
 }
 
 void Texture::bind(GLenum target)
@@ -1242,6 +1375,9 @@ void Texture::load(GLenum target, std::string filename, GLint level)
 
         glTexImage2D(target, level, formats[comp - 1], width,
             height, 0, formats[comp - 1], GL_UNSIGNED_BYTE, image);
+        if (level == 0) {
+            glResources().setBytes(m_handle, std::size_t(width) * height * comp);
+        }
 
         glPixelStorei(GL_UNPACK_ALIGNMENT, 4);        //Return to default
     }
@@ -1269,20 +1405,20 @@ VertexArray::VertexArray(
 void VertexArray::alloc() {
     dealloc();
     glGenVertexArrays(1, &m_vertexArrayID);
+    m_handle = glResources().create(givr::GLResourceKind::VertexArray, m_vertexArrayID);
 }
 
 void VertexArray::dealloc() {
-    if (m_vertexArrayID) {
-        glDeleteVertexArrays(1, &m_vertexArrayID);
-        m_vertexArrayID = 0;
-    }
+    glResources().release(m_handle);
+    m_vertexArrayID = 0;
+    m_handle = {};
 }
 
 void VertexArray::bind() {
-    glBindVertexArray(m_vertexArrayID);
+    glState().bindVertexArray(m_vertexArrayID);
 }
 void VertexArray::unbind() {
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
 }
 
 VertexArray::~VertexArray() {
@@ -1292,9 +1428,312 @@ VertexArray::~VertexArray() {
 // END vertex_array.cpp
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Start render_stats.cpp
+//------------------------------------------------------------------------------
+
+givr::RenderStats &givr::renderStats() {
+    static RenderStats stats;
+    return stats;
+}
+//------------------------------------------------------------------------------
+// END render_stats.cpp
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start gl_state.cpp
+//------------------------------------------------------------------------------
+
+using GLState = givr::GLState;
+
+GLState::GLState()
+    : m_capabilities{{{GL_BLEND, kUnknown},
+                      {GL_DEPTH_TEST, kUnknown},
+                      {GL_MULTISAMPLE, kUnknown},
+                      {GL_LINE_SMOOTH, kUnknown}}} {
+    invalidate();
+}
+
+void GLState::enable(GLenum capability) {
+    setCapability(capability, true);
+}
+
+void GLState::disable(GLenum capability) {
+    setCapability(capability, false);
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination) {
+    bool sourceChanges = changes(m_blendSource, int(source));
+    if (changes(m_blendDestination, int(destination)) || sourceChanges) {
+        glBlendFunc(source, destination);
+    }
+}
+
+void GLState::polygonMode(GLenum face, GLenum mode) {
+    bool faceChanges = changes(m_polygonFace, int(face));
+    if (changes(m_polygonMode, int(mode)) || faceChanges) {
+        glPolygonMode(face, mode);
+    }
+}
+
+void GLState::lineWidth(float width) {
+    if (width == m_lineWidth) {
+        ++renderStats().stateChangesElided;
+        return;
+    }
+    m_lineWidth = width;
+    ++renderStats().stateChanges;
+    glLineWidth(width);
+}
+
+void GLState::useProgram(GLuint program) {
+    if (changes(m_program, int(program))) {
+        glUseProgram(program);
+    }
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+    if (changes(m_vertexArray, int(vertexArray))) {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    if (target != GL_ARRAY_BUFFER) {
+        ++renderStats().stateChanges;
+        glBindBuffer(target, buffer);
+    } else if (changes(m_arrayBuffer, int(buffer))) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::deleteProgram(GLuint program) {
+    if (m_program == int(program)) {
+        m_program = 0;
+    }
+    glDeleteProgram(program);
+}
+
+void GLState::deleteVertexArray(GLuint vertexArray) {
+    if (m_vertexArray == int(vertexArray)) {
+        m_vertexArray = 0;
+    }
+    glDeleteVertexArrays(1, &vertexArray);
+}
+
+void GLState::deleteBuffer(GLuint buffer) {
+    if (m_arrayBuffer == int(buffer)) {
+        m_arrayBuffer = 0;
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void GLState::invalidate() {
+    for (auto &capability : m_capabilities) {
+        capability.enabled = kUnknown;
+    }
+    m_blendSource = m_blendDestination = kUnknown;
+    m_polygonFace = m_polygonMode = kUnknown;
+    m_lineWidth = -1.f;
+    m_program = m_vertexArray = m_arrayBuffer = kUnknown;
+}
+
+// counts the call either way, true if GL has to be told
+bool GLState::changes(int &shadow, int value) {
+    if (shadow == value) {
+        ++renderStats().stateChangesElided;
+        return false;
+    }
+    shadow = value;
+    ++renderStats().stateChanges;
+    return true;
+}
+
+void GLState::setCapability(GLenum capability, bool enabled) {
+    for (auto &shadow : m_capabilities) {
+        if (shadow.name == capability) {
+            if (!changes(shadow.enabled, enabled ? 1 : 0)) {
+                return;
+            }
+            break;
+        }
+    }
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+givr::GLState &givr::glState() {
+    static GLState state;
+    return state;
+}
+//------------------------------------------------------------------------------
+// END gl_state.cpp
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start gl_resources.cpp
+//------------------------------------------------------------------------------
+
+using GLResources = givr::GLResources;
+using GLResourceKind = givr::GLResourceKind;
+using GLHandle = givr::GLHandle;
+
+char const *givr::glResourceKindName(GLResourceKind kind) {
+    switch (kind) {
+    case GLResourceKind::Buffer: return "buffers";
+    case GLResourceKind::Texture: return "textures";
+    case GLResourceKind::VertexArray: return "vertex arrays";
+    case GLResourceKind::Program: return "programs";
+    }
+    return "unknown";
+}
+
+GLHandle GLResources::create(GLResourceKind kind, GLuint name) {
+    std::uint32_t index;
+    if (m_free.empty()) {
+        index = std::uint32_t(m_slots.size());
+        m_slots.emplace_back();
+    } else {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    auto &slot = m_slots[index];
+    slot.kind = kind;
+    slot.name = name;
+    slot.references = 1;
+    slot.bytes = 0;
+    ++m_live[std::size_t(kind)].count;
+    return {index + 1, slot.generation};
+}
+
+GLuint GLResources::name(GLHandle handle) const {
+    auto const *found = slot(handle);
+    return found ? found->name : 0;
+}
+
+void GLResources::retain(GLHandle handle) {
+    if (auto *found = slot(handle)) {
+        ++found->references;
+    }
+}
+
+void GLResources::release(GLHandle handle) {
+    auto *found = slot(handle);
+    if (!found || --found->references > 0) {
+        return;
+    }
+    // stale from here on, the slot is reused once the object is deleted
+    ++found->generation;
+    m_released.push_back(handle.index - 1);
+}
+
+void GLResources::setBytes(GLHandle handle, std::size_t bytes) {
+    if (auto *found = slot(handle)) {
+        auto &live = m_live[std::size_t(found->kind)];
+        live.bytes = live.bytes - found->bytes + bytes;
+        found->bytes = bytes;
+    }
+}
+
+void GLResources::collect() {
+    if (!m_released.empty()) {
+        Retired retired;
+        retired.slots = std::move(m_released);
+        m_released.clear();
+        // without sync objects (before GL 3.2) the driver has to keep them
+        // alive until it is done, as glDelete* promises anyway
+        if (GLAD_GL_VERSION_3_2) {
+            retired.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        m_retired.push_back(std::move(retired));
+    }
+    while (!m_retired.empty()) {
+        auto &oldest = m_retired.front();
+        if (oldest.fence) {
+            auto status = glClientWaitSync(oldest.fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                break; // and so are the ones after it
+            }
+            glDeleteSync(oldest.fence);
+        }
+        for (auto index : oldest.slots) {
+            destroy(index);
+        }
+        m_retired.pop_front();
+    }
+}
+
+void GLResources::flush() {
+    for (auto &retired : m_retired) {
+        if (retired.fence) {
+            glDeleteSync(retired.fence);
+        }
+        for (auto index : retired.slots) {
+            destroy(index);
+        }
+    }
+    m_retired.clear();
+    for (auto index : m_released) {
+        destroy(index);
+    }
+    m_released.clear();
+}
+
+GLResources::Usage GLResources::live(GLResourceKind kind) const {
+    return m_live[std::size_t(kind)];
+}
+
+std::size_t GLResources::pending() const {
+    auto count = m_released.size();
+    for (auto const &retired : m_retired) {
+        count += retired.slots.size();
+    }
+    return count;
+}
+
+GLResources::Slot *GLResources::slot(GLHandle handle) {
+    if (handle.index == 0 || handle.index > m_slots.size()) {
+        return nullptr;
+    }
+    auto &found = m_slots[handle.index - 1];
+    return found.generation == handle.generation ? &found : nullptr;
+}
+
+GLResources::Slot const *GLResources::slot(GLHandle handle) const {
+    return const_cast<GLResources *>(this)->slot(handle);
+}
+
+void GLResources::destroy(std::uint32_t index) {
+    auto &slot = m_slots[index];
+    switch (slot.kind) {
+    case GLResourceKind::Buffer: glState().deleteBuffer(slot.name); break;
+    case GLResourceKind::Texture: glDeleteTextures(1, &slot.name); break;
+    case GLResourceKind::VertexArray: glState().deleteVertexArray(slot.name); break;
+    case GLResourceKind::Program: glState().deleteProgram(slot.name); break;
+    }
+    auto &live = m_live[std::size_t(slot.kind)];
+    --live.count;
+    live.bytes -= slot.bytes;
+    slot.name = 0;
+    slot.bytes = 0;
+    m_free.push_back(index);
+}
+
+givr::GLResources &givr::glResources() {
+    static GLResources resources;
+    return resources;
+}
+//------------------------------------------------------------------------------
+// END gl_resources.cpp
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // Start buffer.cpp
 //------------------------------------------------------------------------------
+#include <algorithm>
 #include <cassert>
 
 using Buffer = givr::Buffer;
@@ -1305,21 +1744,53 @@ Buffer::Buffer(
     alloc();
 }
 
+Buffer::Buffer(Buffer &&other)
+  : m_bufferID{std::exchange(other.m_bufferID, 0)},
+    m_handle{std::exchange(other.m_handle, givr::GLHandle{})}
+{
+}
+
+Buffer &Buffer::operator=(Buffer &&rhs) {
+    std::swap(m_bufferID, rhs.m_bufferID);
+    std::swap(m_handle, rhs.m_handle);
+    return *this;
+}
+
 void Buffer::alloc() {
     dealloc();
     glGenBuffers(1, &m_bufferID);
+    m_handle = glResources().create(givr::GLResourceKind::Buffer, m_bufferID);
 }
 void Buffer::dealloc() {
-    if (m_bufferID) {
-        glDeleteBuffers(1, &m_bufferID);
+    glResources().release(m_handle);
+    m_bufferID = 0;
+    m_handle = {};
+}
+
+GLenum givr::uploadIndices(Buffer &indices, std::vector<std::uint32_t> const &data, GLenum usage) {
+    auto largest = std::max_element(std::begin(data), std::end(data));
+    if (largest == std::end(data) || *largest > 0xffff) {
+        indices.data(GL_ELEMENT_ARRAY_BUFFER, data, usage);
+        return GL_UNSIGNED_INT;
+    }
+    std::vector<std::uint16_t> narrow(std::begin(data), std::end(data));
+    indices.data(GL_ELEMENT_ARRAY_BUFFER, narrow, usage);
+    return GL_UNSIGNED_SHORT;
+}
+
+GLsizei givr::indexSize(GLenum indexType) {
+    switch (indexType) {
+    case GL_UNSIGNED_BYTE: return 1;
+    case GL_UNSIGNED_SHORT: return 2;
+    default: return 4;
     }
 }
 
 void Buffer::bind(GLenum target) {
-    glBindBuffer(target, m_bufferID);
+    glState().bindBuffer(target, m_bufferID);
 }
 void Buffer::unbind(GLenum target) {
-    glBindBuffer(target, 0);
+    glState().bindBuffer(target, 0);
 }
 
 Buffer::~Buffer() {
@@ -1329,3 +1800,531 @@ Buffer::~Buffer() {
 // END buffer.cpp
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Start asset_registry.cpp
+//------------------------------------------------------------------------------
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+using AssetRegistry = givr::AssetRegistry;
+using MeshAsset = givr::MeshAsset;
+using SharedBuffers = givr::SharedBuffers;
+
+namespace {
+// FNV-1a, enough to tell the versions of one file apart
+std::uint64_t contentHash(std::string const &bytes) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char byte : bytes) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    return hash;
+}
+} // namespace
+
+AssetRegistry &AssetRegistry::instance() {
+    static AssetRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<MeshAsset const> AssetRegistry::mesh(std::string const &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+    std::string bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    std::error_code error;
+    auto canonical = std::filesystem::weakly_canonical(path, error).string();
+    if (error) {
+        canonical = path;
+    }
+    std::ostringstream key;
+    key << canonical << '#' << std::hex << contentHash(bytes);
+
+    auto &cached = m_meshes[canonical];
+    if (!cached || cached->key != key.str()) {
+        auto asset = std::make_shared<MeshAsset>();
+        asset->key = key.str();
+        asset->data = geometry::loadMeshFile(path.c_str());
+        cached = std::move(asset);
+    }
+    return cached;
+}
+
+std::shared_ptr<SharedBuffers> AssetRegistry::buffers(std::string const &key, std::size_t count, bool &fresh) {
+    auto &entry = m_buffers[key];
+    auto shared = entry.lock();
+    fresh = !shared || shared->buffers.size() != count;
+    if (fresh) {
+        shared = std::make_shared<SharedBuffers>();
+        for (std::size_t i = 0; i < count; ++i) {
+            shared->buffers.push_back(std::make_shared<Buffer>());
+        }
+        entry = shared;
+    }
+    // forget the sets no renderable holds anymore
+    for (auto it = std::begin(m_buffers); it != std::end(m_buffers);) {
+        it = it->second.expired() ? m_buffers.erase(it) : std::next(it);
+    }
+    return shared;
+}
+
+std::size_t AssetRegistry::meshCount() const {
+    return m_meshes.size();
+}
+
+std::size_t AssetRegistry::bufferSetCount() const {
+    std::size_t held = 0;
+    for (auto const &[key, entry] : m_buffers) {
+        held += entry.expired() ? 0 : 1;
+    }
+    return held;
+}
+//------------------------------------------------------------------------------
+// END asset_registry.cpp
+//------------------------------------------------------------------------------
+
+
+//------------------------------------------------------------------------------
+// Start gpu_timer.cpp
+//------------------------------------------------------------------------------
+#include <cstdlib>
+
+using GpuTimers = givr::GpuTimers;
+
+GpuTimers &GpuTimers::instance() {
+    static GpuTimers timers;
+    return timers;
+}
+
+GpuTimers::GpuTimers() {
+    char const *env = std::getenv("GIVR_GPU_TIMERS");
+    m_enabled = env && env[0] == '1';
+}
+
+bool GpuTimers::supported() const {
+    return GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+}
+
+bool GpuTimers::enabled() const {
+    return m_enabled && supported();
+}
+
+void GpuTimers::setEnabled(bool enabled) {
+    m_enabled = enabled;
+}
+
+void GpuTimers::begin(std::string const &name) {
+    if (!enabled() || m_open) {
+        return;
+    }
+
+    auto &frame = m_frames[m_current];
+    if (frame.used == frame.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+        frame.names.emplace_back();
+    }
+    frame.names[frame.used] = name;
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.used]);
+    m_open = true;
+}
+
+void GpuTimers::end() {
+    if (!m_open) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    ++m_frames[m_current].used;
+    m_open = false;
+}
+
+void GpuTimers::endFrame() {
+    end();
+    m_current = (m_current + 1) % kFramesInFlight;
+
+    // the slot about to be reused holds the oldest frame in flight
+    auto &oldest = m_frames[m_current];
+    if (oldest.used > 0) {
+        // queries finish in order, so the last one stands in for all of them
+        GLint available = 0;
+        glGetQueryObjectiv(oldest.queries[oldest.used - 1],
+                           GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            m_lastFrame.clear();
+            for (size_t i = 0; i < oldest.used; ++i) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(oldest.queries[i], GL_QUERY_RESULT,
+                                      &elapsed);
+                m_lastFrame.push_back({oldest.names[i], elapsed * 1e-6});
+            }
+        }
+        // else the GPU is more than kFramesInFlight behind, drop the frame
+    }
+    oldest.used = 0;
+}
+
+std::vector<GpuTimers::Sample> const &GpuTimers::lastFrame() const {
+    return m_lastFrame;
+}
+//------------------------------------------------------------------------------
+// END gpu_timer.cpp
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start instanced_renderer.cpp
+//------------------------------------------------------------------------------
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+void givr::quantizePositions(std::vector<float> const &positions,
+                             std::uint16_t dimensions,
+                             std::vector<std::int16_t> &encoded, vec3f &offset,
+                             vec3f &scale) {
+    size_t count = positions.size() / dimensions;
+    size_t axes = std::min<size_t>(dimensions, 3);
+    vec3f lower(std::numeric_limits<float>::max());
+    vec3f upper(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t axis = 0; axis < axes; ++axis) {
+            lower[axis] = std::min(lower[axis], positions[i * dimensions + axis]);
+            upper[axis] = std::max(upper[axis], positions[i * dimensions + axis]);
+        }
+    }
+    offset = count ? 0.5f * (lower + upper) : vec3f{0.f};
+    // a flat axis keeps a scale of 1 so its zeros decode to the offset
+    scale = count ? 0.5f * (upper - lower) : vec3f{1.f};
+    for (size_t axis = 0; axis < 3; ++axis) {
+        if (axis >= axes || scale[axis] <= 0.f) {
+            scale[axis] = 1.f;
+        }
+    }
+
+    // x, y, z and a pad, so every vertex starts on 4 bytes
+    encoded.assign(count * 4, 0);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t axis = 0; axis < axes; ++axis) {
+            float unit = (positions[i * dimensions + axis] - offset[axis]) / scale[axis];
+            encoded[i * 4 + axis] = std::int16_t(std::round(glm::clamp(unit, -1.f, 1.f) * 32767.f));
+        }
+    }
+}
+
+void givr::octahedralNormals(std::vector<float> const &normals,
+                             std::uint16_t dimensions,
+                             std::vector<std::int16_t> &encoded) {
+    size_t count = normals.size() / dimensions;
+    encoded.resize(count * 2);
+    for (size_t i = 0; i < count; ++i) {
+        vec3f n{normals[i * dimensions], normals[i * dimensions + 1],
+                dimensions > 2 ? normals[i * dimensions + 2] : 0.f};
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        glm::vec2 e = l1 > 0.f ? glm::vec2(n) / l1 : glm::vec2(0.f);
+        if (n.z < 0.f) {
+            // fold the lower hemisphere over the diagonals
+            e = (1.f - glm::abs(glm::vec2(e.y, e.x))) *
+                glm::vec2(e.x >= 0.f ? 1.f : -1.f, e.y >= 0.f ? 1.f : -1.f);
+        }
+        encoded[i * 2] = std::int16_t(std::round(glm::clamp(e.x, -1.f, 1.f) * 32767.f));
+        encoded[i * 2 + 1] = std::int16_t(std::round(glm::clamp(e.y, -1.f, 1.f) * 32767.f));
+    }
+}
+
+void givr::halfFloats(std::vector<float> const &values,
+                      std::vector<std::uint16_t> &encoded) {
+    encoded.resize((values.size() + 1) / 2 * 2);
+    for (size_t i = 0; i < values.size(); i += 2) {
+        float second = i + 1 < values.size() ? values[i + 1] : 0.f;
+        auto packed = glm::packHalf2x16(glm::vec2(values[i], second));
+        encoded[i] = std::uint16_t(packed & 0xffff);
+        encoded[i + 1] = std::uint16_t(packed >> 16);
+    }
+    encoded.resize(values.size());
+}
+
+givr::mat4f givr::normalizeMesh(std::vector<float> &positions,
+                               std::uint16_t dimensions) {
+    size_t count = positions.size() / dimensions;
+    size_t axes = std::min<size_t>(dimensions, 3);
+    if (count == 0) {
+        return mat4f{1.f};
+    }
+    vec3f lower(std::numeric_limits<float>::max());
+    vec3f upper(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t axis = 0; axis < axes; ++axis) {
+            lower[axis] = std::min(lower[axis], positions[i * dimensions + axis]);
+            upper[axis] = std::max(upper[axis], positions[i * dimensions + axis]);
+        }
+    }
+    vec3f centre{0.f};
+    float extent = 0.f;
+    for (size_t axis = 0; axis < axes; ++axis) {
+        centre[axis] = 0.5f * (lower[axis] + upper[axis]);
+        extent = std::max(extent, 0.5f * (upper[axis] - lower[axis]));
+    }
+    if (extent <= 0.f) {
+        extent = 1.f;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t axis = 0; axis < axes; ++axis) {
+            auto &p = positions[i * dimensions + axis];
+            p = (p - centre[axis]) / extent;
+        }
+    }
+    mat4f decode = glm::scale(mat4f{1.f}, vec3f{extent});
+    decode[3] = glm::vec4(centre, 1.f);
+    return decode;
+}
+
+GLsizei givr::instanceStride(InstanceLayout layout) {
+    switch (layout) {
+    case InstanceLayout::Mat4: return sizeof(mat4f);
+    case InstanceLayout::Affine3x4: return 3 * sizeof(glm::vec4);
+    case InstanceLayout::TQS: return 2 * sizeof(glm::vec4);
+    case InstanceLayout::TQSHalf: return sizeof(glm::vec4) + sizeof(std::uint64_t);
+    }
+    return sizeof(mat4f);
+}
+
+std::string givr::instanceModelSource(InstanceLayout layout) {
+    switch (layout) {
+    case InstanceLayout::Mat4:
+        return "";
+    case InstanceLayout::Affine3x4:
+        return R"shader(
+        #define POSE_MODEL
+        layout(location=0) in vec4 instanceRow0;
+        layout(location=1) in vec4 instanceRow1;
+        layout(location=2) in vec4 instanceRow2;
+
+        mat4 poseModel() {
+            return transpose(mat4(instanceRow0, instanceRow1, instanceRow2,
+                                  vec4(0.0, 0.0, 0.0, 1.0)));
+        }
+        )shader";
+    case InstanceLayout::TQS:
+    case InstanceLayout::TQSHalf:
+        return R"shader(
+        #define POSE_MODEL
+        layout(location=0) in vec4 instanceTranslationScale;
+        layout(location=1) in vec4 instanceRotation; // x, y, z, w
+
+        mat4 poseModel() {
+            vec4 q = normalize(instanceRotation);
+            float s = instanceTranslationScale.w;
+            vec3 x = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z),
+                          2.0 * (q.x * q.y + q.w * q.z),
+                          2.0 * (q.x * q.z - q.w * q.y));
+            vec3 y = vec3(2.0 * (q.x * q.y - q.w * q.z),
+                          1.0 - 2.0 * (q.x * q.x + q.z * q.z),
+                          2.0 * (q.y * q.z + q.w * q.x));
+            vec3 z = vec3(2.0 * (q.x * q.z + q.w * q.y),
+                          2.0 * (q.y * q.z - q.w * q.x),
+                          1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+            return mat4(vec4(s * x, 0.0), vec4(s * y, 0.0), vec4(s * z, 0.0),
+                        vec4(instanceTranslationScale.xyz, 1.0));
+        }
+        )shader";
+    }
+    return "";
+}
+
+void givr::setInstanceAttributes(InstanceLayout layout, GLuint firstInstance) {
+    GLsizei stride = instanceStride(layout);
+    std::size_t first = std::size_t(firstInstance) * stride;
+    GLuint vec4Count = 4;
+    switch (layout) {
+    case InstanceLayout::Mat4: vec4Count = 4; break;
+    case InstanceLayout::Affine3x4: vec4Count = 3; break;
+    case InstanceLayout::TQS: vec4Count = 2; break;
+    case InstanceLayout::TQSHalf: vec4Count = 1; break;
+    }
+    GLuint index = 0;
+    for (; index < vec4Count; ++index) {
+        glVertexAttribPointer(index, 4, GL_FLOAT, GL_FALSE, stride,
+                              (GLvoid *)(first + index * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(index);
+        glVertexAttribDivisor(index, 1);
+    }
+    if (layout == InstanceLayout::TQSHalf) {
+        glVertexAttribPointer(index, 4, GL_HALF_FLOAT, GL_FALSE, stride,
+                              (GLvoid *)(first + sizeof(glm::vec4)));
+        glEnableVertexAttribArray(index);
+        glVertexAttribDivisor(index, 1);
+        ++index;
+    }
+    for (; index < 4; ++index) {
+        glDisableVertexAttribArray(index);
+    }
+}
+
+void givr::encodeInstances(InstanceLayout layout, std::vector<mat4f> const &models,
+                           std::vector<std::uint8_t> &encoded) {
+    auto stride = size_t(instanceStride(layout));
+    encoded.resize(models.size() * stride);
+    std::uint8_t *out = encoded.data();
+    for (auto const &m : models) {
+        if (layout == InstanceLayout::Mat4) {
+            std::memcpy(out, &m, sizeof(mat4f));
+        } else if (layout == InstanceLayout::Affine3x4) {
+            glm::mat4 rows = glm::transpose(m);
+            std::memcpy(out, &rows, 3 * sizeof(glm::vec4));
+        } else {
+            // uniform scale from the first column, its sign from the handedness
+            glm::mat3 basis(m);
+            float scale = glm::length(basis[0]);
+            if (glm::determinant(basis) < 0.f) {
+                scale = -scale;
+            }
+            glm::quat q = glm::quat_cast(scale != 0.f ? basis / scale : glm::mat3(1.f));
+            glm::vec4 translationScale(glm::vec3(m[3]), scale);
+            glm::vec4 rotation(q.x, q.y, q.z, q.w);
+            std::memcpy(out, &translationScale, sizeof(glm::vec4));
+            if (layout == InstanceLayout::TQS) {
+                std::memcpy(out + sizeof(glm::vec4), &rotation, sizeof(glm::vec4));
+            } else {
+                std::uint64_t half = glm::packHalf4x16(rotation);
+                std::memcpy(out + sizeof(glm::vec4), &half, sizeof(half));
+            }
+        }
+        out += stride;
+    }
+}
+//------------------------------------------------------------------------------
+// END instanced_renderer.cpp
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start multi_mesh_renderer.cpp
+//------------------------------------------------------------------------------
+
+// the commands' baseInstance must be honoured, which plain
+// ARB_multi_draw_indirect on a pre 4.2 context does not do
+bool givr::multiDrawIndirectSupported() {
+    return GLAD_GL_VERSION_4_3 ||
+           (GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance);
+}
+//------------------------------------------------------------------------------
+// END multi_mesh_renderer.cpp
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start render_queue.cpp
+//------------------------------------------------------------------------------
+
+#include <array>
+
+void givr::radixSort(std::vector<SortEntry> &entries,
+                     std::vector<SortEntry> &scratch) {
+    constexpr size_t kDigits = sizeof(std::uint64_t);
+    size_t n = entries.size();
+    if (n < 2) {
+        return;
+    }
+
+    // one pass for all the histograms, a digit every entry shares is skipped
+    std::array<std::array<std::uint32_t, 256>, kDigits> counts{};
+    for (auto const &entry : entries) {
+        for (size_t digit = 0; digit < kDigits; ++digit) {
+            ++counts[digit][(entry.key >> (8 * digit)) & 0xff];
+        }
+    }
+
+    scratch.resize(n);
+    for (size_t digit = 0; digit < kDigits; ++digit) {
+        auto &count = counts[digit];
+        if (count[(entries.front().key >> (8 * digit)) & 0xff] == n) {
+            continue;
+        }
+        std::uint32_t offset = 0;
+        for (auto &c : count) {
+            auto next = offset + c;
+            c = offset;
+            offset = next;
+        }
+        for (auto const &entry : entries) {
+            scratch[count[(entry.key >> (8 * digit)) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+namespace {
+
+// unsigned order matching the float order, negative depths included
+std::uint32_t orderedBits(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+} // namespace
+
+std::uint64_t givr::renderSortKey(RenderPass pass, std::uint16_t program,
+                                  GLuint mesh, std::uint64_t material,
+                                  float depth) {
+    auto key = (std::uint64_t(pass) & 0xf) << 60;
+    if (pass == RenderPass::Transparent) {
+        // blending needs far to near, whatever the program
+        return key | std::uint64_t(~orderedBits(depth)) << 28;
+    }
+    material ^= material >> 32;
+    material ^= material >> 16;
+    return key | std::uint64_t(program) << 44 |
+           (std::uint64_t(mesh) & 0xffff) << 28 |
+           (material & 0xffff) << 12;
+}
+
+void givr::RenderQueue::push(std::uint64_t key, RenderPass pass,
+                             void *context, void const *type,
+                             std::function<bool(void *)> merge,
+                             std::function<void()> draw) {
+    m_submissions.push_back(
+        {key, pass, context, type, std::move(merge), std::move(draw)});
+}
+
+void givr::RenderQueue::execute() {
+    m_order.clear();
+    for (size_t i = 0; i < m_submissions.size(); ++i) {
+        m_order.push_back({m_submissions[i].key, std::uint32_t(i)});
+    }
+    radixSort(m_order, m_scratch);
+
+    for (size_t i = 0; i < m_order.size(); ++i) {
+        auto &submission = m_submissions[m_order[i].index];
+        if (submission.merged) {
+            continue;
+        }
+        // mergeable submissions have equal keys, so they follow this one;
+        // blended ones only take their own repeats
+        for (size_t j = i + 1; submission.merge && j < m_order.size() &&
+                               m_order[j].key == m_order[i].key;
+             ++j) {
+            auto &other = m_submissions[m_order[j].index];
+            if (other.merged || other.type != submission.type ||
+                (submission.pass == RenderPass::Transparent &&
+                 other.context != submission.context)) {
+                continue;
+            }
+            if (submission.merge(other.context)) {
+                other.merged = true;
+                ++renderStats().mergedDraws;
+            }
+        }
+        submission.draw();
+    }
+    m_submissions.clear();
+}
+//------------------------------------------------------------------------------
+// END render_queue.cpp
+//------------------------------------------------------------------------------
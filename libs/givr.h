@@ -11055,6 +11055,7 @@ GLenum getBufferUsageType(BufferUsageType const &d);
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <cstdint>
 #include <string>
 
 namespace givr {
@@ -11074,15 +11075,100 @@ public:
   Shader &operator=(const Shader &) = delete;
 
   operator GLuint() const { return m_shaderID; }
+  // FNV-1a of the source and type, equal for equal shaders
+  std::uint64_t sourceHash() const { return m_sourceHash; }
 
 private:
   GLuint m_shaderID = 0;
+  std::uint64_t m_sourceHash = 0;
 };
 }; // end namespace givr
 //------------------------------------------------------------------------------
 // END shader.h
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Start gl_resources.h
+//------------------------------------------------------------------------------
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace givr {
+
+enum class GLResourceKind { Buffer, Texture, VertexArray, Program };
+constexpr std::size_t kGLResourceKinds = 4;
+char const *glResourceKindName(GLResourceKind kind);
+
+// names a GL object owned by GLResources, stale (and resolving to 0) once
+// the object is released, even if its slot is reused
+struct GLHandle {
+  std::uint32_t index = 0; // slot + 1, 0 for none
+  std::uint32_t generation = 0;
+};
+
+// Every GL object givr creates. Objects are reference counted by their
+// wrappers (Buffer, Texture, VertexArray, Program); the last release queues
+// the object, and collect() deletes it once a fence shows the GPU finished
+// the frame that released it. Byte counts are what the wrappers uploaded,
+// kept until the object is deleted.
+class GLResources {
+public:
+  struct Usage {
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+  };
+
+  GLHandle create(GLResourceKind kind, GLuint name);
+  GLuint name(GLHandle handle) const; // 0 if stale
+  void retain(GLHandle handle);
+  void release(GLHandle handle);
+  // the object's storage, replacing what it had
+  void setBytes(GLHandle handle, std::size_t bytes);
+
+  // once per frame, after its commands are submitted
+  void collect();
+  // deletes everything released without waiting, while the context is
+  // still current
+  void flush();
+
+  Usage live(GLResourceKind kind) const; // not deleted yet
+  std::size_t pending() const;
+
+private:
+  struct Slot {
+    GLResourceKind kind = GLResourceKind::Buffer;
+    GLuint name = 0;
+    std::uint32_t generation = 1;
+    std::uint32_t references = 0;
+    std::size_t bytes = 0;
+  };
+  struct Retired {
+    std::vector<std::uint32_t> slots;
+    GLsync fence = nullptr;
+  };
+
+  Slot *slot(GLHandle handle);
+  Slot const *slot(GLHandle handle) const;
+  void destroy(std::uint32_t slot);
+
+  std::vector<Slot> m_slots;
+  std::vector<std::uint32_t> m_free;
+  std::vector<std::uint32_t> m_released; // since the last collect
+  std::deque<Retired> m_retired;         // oldest first
+  std::array<Usage, kGLResourceKinds> m_live{};
+};
+
+GLResources &glResources();
+
+}; // end namespace givr
+//------------------------------------------------------------------------------
+// END gl_resources.h
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // Start texture.h
 //------------------------------------------------------------------------------
@@ -11097,6 +11183,10 @@ public:
   // TODO(lw): make a version that just receives the source directly.
   ~Texture();
 
+  // copies share the texture (styles keep theirs by value), see GLResources
+  Texture(const Texture &other);
+  Texture &operator=(const Texture &rhs);
+
   operator GLuint() const { return m_textureID; }
   void alloc();
   void dealloc();
@@ -11105,6 +11195,7 @@ public:
 
 private:
   GLuint m_textureID = 0;
+  GLHandle m_handle;
 };
 }; // end namespace givr
 //------------------------------------------------------------------------------
@@ -11122,6 +11213,9 @@ public:
   // TODO(lw): make a version that just receives the source directly.
   ~VertexArray();
 
+  VertexArray(const VertexArray &) = delete;
+  VertexArray &operator=(const VertexArray &) = delete;
+
   operator GLuint() const { return m_vertexArrayID; }
   void alloc();
   void dealloc();
@@ -11130,6 +11224,7 @@ public:
 
 private:
   GLuint m_vertexArrayID = 0;
+  GLHandle m_handle;
 };
 }; // end namespace givr
 //------------------------------------------------------------------------------
@@ -11604,8 +11699,22 @@ template <class T> struct hash<gsl::strict_not_null<T>> {
 
 // This class is used for compile time checking that the data
 // is compatible with the style.
+#include <string>
+#include <vector>
+
 namespace givr {
-template <givr::PrimitiveType PrimitiveValue> class VertexArrayData {};
+template <givr::PrimitiveType PrimitiveValue> class VertexArrayData {
+public:
+  // names the asset this data came from and how it was prepared, renderables
+  // with the same key share their buffers (see AssetRegistry), empty if the
+  // data is generated
+  std::string assetKey;
+
+  // per triangle data filled by styles that need it (see Phong): a vec3 per
+  // vertex for the wireframe, and whether the normals are per face
+  std::vector<float> barycentrics;
+  bool flatNormals = false;
+};
 
 // A constexpr function for determining the primitive type from
 // the geometry type.
@@ -11906,11 +12015,15 @@ class Program {
 public:
   Program(GLuint vertex, GLuint fragment);
   Program(GLuint vertex, GLuint geometry, GLuint fragment);
+  // programs linked from the same shader sources share a variant
+  Program(Shader const &vertex, Shader const &fragment);
+  Program(Shader const &vertex, Shader const &geometry,
+          Shader const &fragment);
   ~Program();
 
-  // Default ctor/dtor & move operations
-  Program(Program &&other) = default;
-  Program &operator=(Program &&rhs) = default;
+  // moved from programs own nothing
+  Program(Program &&other);
+  Program &operator=(Program &&rhs);
 
   // But no copy or assignment. Bad.
   Program(const Program &) = delete;
@@ -11919,6 +12032,11 @@ public:
   operator GLuint() const { return m_programID; }
   void use();
 
+  // small id that stays with the shader sources, unlike the GL name a
+  // rebuilt program gets (see RenderQueue); programs made from bare shader
+  // names each get their own
+  std::uint16_t variant() const { return m_variant; }
+
   void setVec2(const std::string &name, vec2f const &value) const;
   void setVec3(const std::string &name, vec3f const &value) const;
   void setMat4(const std::string &name, mat4f const &mat) const;
@@ -11939,6 +12057,8 @@ public:
 private:
   void linkAndErrorCheck();
   GLuint m_programID = 0;
+  GLHandle m_handle;
+  std::uint16_t m_variant = 0;
 };
 }; // end namespace givr
 //------------------------------------------------------------------------------
@@ -15600,6 +15720,92 @@ Sphere::Data generateGeometry(Sphere const &s);
 // END sphere.h
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Start render_stats.h
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+
+namespace givr {
+
+// Work submitted since the last reset, for per-frame counters
+struct RenderStats {
+  std::uint64_t drawCalls = 0;
+  std::uint64_t instances = 0;
+  std::uint64_t bytesUploaded = 0;
+  std::uint64_t stateChanges = 0; // issued through GLState
+  std::uint64_t stateChangesElided = 0;
+  std::uint64_t mergedDraws = 0; // RenderQueue submissions drawn by another
+};
+
+RenderStats &renderStats();
+
+}; // end namespace givr
+//------------------------------------------------------------------------------
+// END render_stats.h
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start gl_state.h
+//------------------------------------------------------------------------------
+
+#include <array>
+
+namespace givr {
+
+// Shadow copy of the GL state givr sets for every draw, calls that would
+// not change anything are skipped (and counted in RenderStats). Code that
+// changes this state behind givr's back (ImGui, raw GL) has to call
+// invalidate() before givr draws again.
+class GLState {
+public:
+  GLState();
+
+  // GL_BLEND, GL_DEPTH_TEST, GL_MULTISAMPLE and GL_LINE_SMOOTH are
+  // shadowed, anything else is passed through
+  void enable(GLenum capability);
+  void disable(GLenum capability);
+  void blendFunc(GLenum source, GLenum destination);
+  void polygonMode(GLenum face, GLenum mode);
+  void lineWidth(float width);
+
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vertexArray);
+  // only GL_ARRAY_BUFFER is shadowed, the element array binding belongs to
+  // the bound vertex array
+  void bindBuffer(GLenum target, GLuint buffer);
+
+  // deleting a bound object binds 0 in its place
+  void deleteProgram(GLuint program);
+  void deleteVertexArray(GLuint vertexArray);
+  void deleteBuffer(GLuint buffer);
+
+  void invalidate();
+
+private:
+  static constexpr int kUnknown = -1;
+  struct Capability {
+    GLenum name;
+    int enabled;
+  };
+
+  bool changes(int &shadow, int value);
+  void setCapability(GLenum capability, bool enabled);
+
+  std::array<Capability, 4> m_capabilities;
+  int m_blendSource, m_blendDestination;
+  int m_polygonFace, m_polygonMode;
+  float m_lineWidth;
+  int m_program, m_vertexArray, m_arrayBuffer;
+};
+
+GLState &glState();
+
+}; // end namespace givr
+//------------------------------------------------------------------------------
+// END gl_state.h
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // Start buffer.h
 //------------------------------------------------------------------------------
@@ -15615,9 +15821,9 @@ public:
   Buffer();
   // TODO(lw): make a version that just receives the source directly.
 
-  // Default ctor/dtor & move operations
-  Buffer(Buffer &&other) = default;
-  Buffer &operator=(Buffer &&rhs) = default;
+  // moved from buffers own nothing
+  Buffer(Buffer &&other);
+  Buffer &operator=(Buffer &&rhs);
 
   // But no copy or assignment. Bad.
   Buffer(const Buffer &) = delete;
@@ -15633,20 +15839,109 @@ public:
   template <typename T>
   void data(GLenum target, const gsl::span<T> &data, GLenum usage) {
     glBufferData(target, sizeof(T) * data.size(), data.data(), usage);
+    renderStats().bytesUploaded += sizeof(T) * data.size();
+    glResources().setBytes(m_handle, sizeof(T) * data.size());
   }
   template <typename T>
   void data(GLenum target, const std::vector<T> &data, GLenum usage) {
     glBufferData(target, sizeof(T) * data.size(), data.data(), usage);
+    renderStats().bytesUploaded += sizeof(T) * data.size();
+    glResources().setBytes(m_handle, sizeof(T) * data.size());
   }
 
 private:
   GLuint m_bufferID = 0;
+  GLHandle m_handle;
 };
+
+// into indices (bound as GL_ELEMENT_ARRAY_BUFFER), as 16 bit indices when
+// they fit, returns the index type to draw with
+GLenum uploadIndices(Buffer &indices, std::vector<std::uint32_t> const &data,
+                     GLenum usage);
+GLsizei indexSize(GLenum indexType);
 }; // end namespace givr
 //------------------------------------------------------------------------------
 // END buffer.h
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Start asset_registry.h
+//------------------------------------------------------------------------------
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace givr {
+
+// a mesh file as parsed, see AssetRegistry
+struct MeshAsset {
+  std::string key; // canonical path # content hash
+  geometry::Mesh::Data data;
+};
+
+// the buffers of one renderable context (indices first), filled once and
+// shared by every context drawing the same data
+struct SharedBuffers {
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  GLenum indexType = GL_UNSIGNED_INT;
+  vec3f positionOffset{0.f}; // VertexFormat::Compact
+  vec3f positionScale{1.f};
+};
+
+// Mesh files are parsed once per canonical path and content hash, so an
+// edited file is a new asset and a renamed or relinked one is not.
+// Parsed meshes stay cached until their file changes; buffers live as long
+// as a renderable holds them.
+class AssetRegistry {
+public:
+  static AssetRegistry &instance();
+
+  // nullptr if the file can't be read
+  std::shared_ptr<MeshAsset const> mesh(std::string const &path);
+
+  // buffers for key (an asset key plus how its data was prepared), fresh if
+  // they were just allocated and still need their data
+  std::shared_ptr<SharedBuffers> buffers(std::string const &key,
+                                         std::size_t count, bool &fresh);
+
+  std::size_t meshCount() const;
+  std::size_t bufferSetCount() const; // held by some renderable
+
+private:
+  // by canonical path
+  std::unordered_map<std::string, std::shared_ptr<MeshAsset const>> m_meshes;
+  std::unordered_map<std::string, std::weak_ptr<SharedBuffers>> m_buffers;
+};
+
+// points ctx's buffers at the ones shared for data's asset, true if they
+// still need their data; data without an asset key keeps (or gets back)
+// buffers of its own
+template <typename ContextT, typename DataT>
+bool adoptSharedBuffers(ContextT &ctx, DataT const &data,
+                        std::string const &form) {
+  if (data.assetKey.empty()) {
+    if (ctx.sharedBuffers) {
+      ctx.sharedBuffers.reset();
+      for (auto &buffer : ctx.arrayBuffers) {
+        buffer = std::make_shared<Buffer>();
+      }
+    }
+    return true;
+  }
+  bool fresh = false;
+  ctx.sharedBuffers = AssetRegistry::instance().buffers(
+      data.assetKey + form, ctx.arrayBuffers.size(), fresh);
+  ctx.arrayBuffers = ctx.sharedBuffers->buffers;
+  return fresh;
+}
+}; // end namespace givr
+//------------------------------------------------------------------------------
+// END asset_registry.h
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // Start gsl_algorithm
 //------------------------------------------------------------------------------
@@ -16449,6 +16744,80 @@ bool operator>=(const T &one, gsl::basic_string_span<CharT, Extent> other) {
 // END string_span
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Start gpu_timer.h
+//------------------------------------------------------------------------------
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace givr {
+
+// GL_TIME_ELAPSED queries around draw calls. Queries are pooled over
+// kFramesInFlight frames and only read back once the GPU reports them as
+// available, so reading never stalls the pipeline (at the cost of results
+// lagging a few frames behind). Time elapsed queries cannot nest; a begin()
+// while another query is open is ignored.
+//
+// Disabled by default, enable with setEnabled(true) or GIVR_GPU_TIMERS=1.
+class GpuTimers {
+public:
+  static constexpr size_t kFramesInFlight = 4;
+
+  struct Sample {
+    std::string name;
+    double milliseconds;
+  };
+
+  static GpuTimers &instance();
+
+  // needs GL 3.3 or ARB_timer_query
+  bool supported() const;
+  bool enabled() const;
+  void setEnabled(bool enabled);
+
+  void begin(std::string const &name);
+  void end();
+
+  // closes the current frame and reads back the oldest one in flight
+  void endFrame();
+
+  // samples of the latest frame the GPU has finished, in submission order
+  std::vector<Sample> const &lastFrame() const;
+
+private:
+  GpuTimers();
+
+  struct Frame {
+    std::vector<GLuint> queries;
+    std::vector<std::string> names;
+    size_t used = 0;
+  };
+
+  std::array<Frame, kFramesInFlight> m_frames;
+  size_t m_current = 0;
+  bool m_enabled = false;
+  bool m_open = false;
+  std::vector<Sample> m_lastFrame;
+};
+
+class GpuTimerScope {
+public:
+  explicit GpuTimerScope(std::string const &name) {
+    GpuTimers::instance().begin(name);
+  }
+  ~GpuTimerScope() { GpuTimers::instance().end(); }
+
+  GpuTimerScope(GpuTimerScope const &) = delete;
+  GpuTimerScope &operator=(GpuTimerScope const &) = delete;
+};
+
+}; // end namespace givr
+//------------------------------------------------------------------------------
+// END gpu_timer.h
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // Start renderer.h
 //------------------------------------------------------------------------------
@@ -16465,17 +16834,25 @@ template <typename GeometryT, typename StyleT> struct RenderContext {
 
   // Keep references to the GL_ARRAY_BUFFERS so that
   // the stay in scope for this context.
-  std::vector<std::unique_ptr<Buffer>> arrayBuffers;
+  std::vector<std::shared_ptr<Buffer>> arrayBuffers;
+  std::shared_ptr<SharedBuffers> sharedBuffers; // see adoptSharedBuffers
 
   GLuint numberOfIndices;
   GLuint startIndex;
   GLuint vertexCount;
+  GLenum indexType = GL_UNSIGNED_INT; // see uploadIndices
 
   PrimitiveType primitive;
 
   bool hasIndices = false;
 
   typename StyleT::Parameters params;
+  bool geometryStage = false; // the program has one (see Phong)
+  bool barycentrics = false;  // the buffers carry them (location 8)
+  bool flatNormals = false;   // the buffers' normals are per face
+
+  // label for GPU timers
+  std::string name = "drawArray";
 
   // Default ctor/dtor & move operations
   RenderContext() = default;
@@ -16494,7 +16871,8 @@ template <typename GeometryT, typename StyleT, typename ViewContextT>
 void drawArray(
     RenderContext<GeometryT, StyleT> &ctx, ViewContextT const &viewCtx,
     std::function<void(std::unique_ptr<Program> const &)> setUniforms) {
-  ctx.shaderProgram->use();
+  GpuTimerScope gpuTimer(ctx.name);
+  glState().useProgram(*ctx.shaderProgram);
 
   mat4f view = viewCtx.camera.viewMatrix();
   mat4f projection = viewCtx.projection.projectionMatrix();
@@ -16504,20 +16882,21 @@ void drawArray(
   ctx.shaderProgram->setMat4("view", view);
   ctx.shaderProgram->setMat4("projection", projection);
   setUniforms(ctx.shaderProgram);
-  ctx.vao->bind();
-  glPolygonMode(GL_FRONT, GL_FILL);
+  glState().bindVertexArray(*ctx.vao);
+  glState().polygonMode(GL_FRONT, GL_FILL);
   GLenum mode = givr::getMode(ctx.primitive);
+  ++renderStats().drawCalls;
+  ++renderStats().instances;
   if constexpr (hasIndices<GeometryT>::value) {
     if (ctx.numberOfIndices > 0) {
-      glDrawElements(mode, ctx.numberOfIndices, GL_UNSIGNED_INT, 0);
+      glDrawElements(mode, ctx.numberOfIndices, ctx.indexType, 0);
     } else {
       glDrawArrays(mode, ctx.startIndex, ctx.vertexCount);
     }
   } else {
     glDrawArrays(mode, ctx.startIndex, ctx.vertexCount);
   }
-
-  ctx.vao->unbind();
+  // the vao stays bound, see GLState
 }
 template <typename GeometryT, typename StyleT>
 void allocateBuffers(RenderContext<GeometryT, StyleT> &ctx) {
@@ -16526,15 +16905,11 @@ void allocateBuffers(RenderContext<GeometryT, StyleT> &ctx) {
 
   if constexpr (hasIndices<GeometryT>::value) {
     // Map - but don't upload indices data
-    std::unique_ptr<Buffer> indices = std::make_unique<Buffer>();
-    indices->alloc();
-    ctx.arrayBuffers.push_back(std::move(indices));
+    ctx.arrayBuffers.push_back(std::make_shared<Buffer>());
   }
 
   auto allocateBuffer = [&ctx]() {
-    std::unique_ptr<Buffer> vbo = std::make_unique<Buffer>();
-    vbo->alloc();
-    ctx.arrayBuffers.push_back(std::move(vbo));
+    ctx.arrayBuffers.push_back(std::make_shared<Buffer>());
   };
 
   // Upload / bind / map model data
@@ -16550,6 +16925,9 @@ void allocateBuffers(RenderContext<GeometryT, StyleT> &ctx) {
   if constexpr (hasColours<GeometryT>::value) {
     allocateBuffer(); // data.colours);
   }
+  if constexpr (isTriangleBased<GeometryT>()) {
+    allocateBuffer(); // data.barycentrics);
+  }
 }
 template <typename GeometryT, typename StyleT>
 void uploadBuffers(RenderContext<GeometryT, StyleT> &ctx,
@@ -16563,29 +16941,35 @@ void uploadBuffers(RenderContext<GeometryT, StyleT> &ctx,
   ctx.startIndex = 0;
   ctx.vertexCount = data.vertices.size() / data.dimensions;
 
+  // another renderable may have uploaded this data already
+  bool fresh = adoptSharedBuffers(ctx, data, "");
+
   std::uint16_t vaIndex = 4;
   ctx.vao->bind();
 
   std::uint16_t bufferIndex = 0;
   if constexpr (hasIndices<GeometryT>::value) {
-    std::unique_ptr<Buffer> &indices = ctx.arrayBuffers[0];
+    auto &indices = ctx.arrayBuffers[0];
     indices->bind(GL_ELEMENT_ARRAY_BUFFER);
-    indices->data(GL_ELEMENT_ARRAY_BUFFER, data.indices,
-                  getBufferUsageType(data.indicesType));
+    if (fresh) {
+      ctx.indexType = uploadIndices(*indices, data.indices,
+                                    getBufferUsageType(data.indicesType));
+    }
     ++bufferIndex;
   }
 
-  auto applyBuffer = [&ctx, &vaIndex, &bufferIndex](
+  auto applyBuffer = [&ctx, &vaIndex, &bufferIndex, fresh](
                          GLenum type, GLuint size, GLenum bufferType,
                          std::string name, gsl::span<const float> const &data) {
     // if this data piece is empty disable this one.
-    std::unique_ptr<Buffer> &vbo = ctx.arrayBuffers[bufferIndex];
+    auto &vbo = ctx.arrayBuffers[bufferIndex];
     vbo->bind(type);
     if (data.size() == 0) {
       glDisableVertexAttribArray(vaIndex);
     } else {
       glBindAttribLocation(*ctx.shaderProgram.get(), vaIndex, name.c_str());
-      vbo->data(type, data, bufferType);
+      if (fresh)
+        vbo->data(type, data, bufferType);
       glVertexAttribPointer(vaIndex, size, GL_FLOAT, GL_FALSE, 0, (GLvoid *)0);
       glEnableVertexAttribArray(vaIndex);
     }
@@ -16611,9 +16995,24 @@ void uploadBuffers(RenderContext<GeometryT, StyleT> &ctx,
     applyBuffer(GL_ARRAY_BUFFER, 3, getBufferUsageType(data.coloursType),
                 "colour", data.colours);
   }
+  if constexpr (isTriangleBased<GeometryT>()) {
+    vaIndex = 8; // past the optional attributes, wherever they stopped
+    applyBuffer(GL_ARRAY_BUFFER, 3, GL_STATIC_DRAW, "barycentric",
+                data.barycentrics);
+  }
+  ctx.barycentrics = !data.barycentrics.empty();
+  ctx.flatNormals = data.flatNormals;
 
   ctx.vao->unbind();
 
+  if (ctx.sharedBuffers) {
+    if (fresh) {
+      ctx.sharedBuffers->indexType = ctx.indexType;
+    } else {
+      ctx.indexType = ctx.sharedBuffers->indexType;
+    }
+  }
+
   if constexpr (hasIndices<GeometryT>::value) {
     ctx.arrayBuffers[0]->unbind(GL_ELEMENT_ARRAY_BUFFER);
     if (ctx.arrayBuffers.size() > 1) {
@@ -16636,24 +17035,79 @@ void uploadBuffers(RenderContext<GeometryT, StyleT> &ctx,
 
 namespace givr {
 
+// how model transforms are packed per instance for upload, chosen per
+// renderable (see createInstancedRenderable)
+enum class InstanceLayout {
+  Mat4,      // 64 bytes
+  Affine3x4, // 48 bytes, the top three rows
+  TQS,       // 32 bytes, translation, uniform scale and rotation quaternion
+  TQSHalf,   // 24 bytes, TQS with the quaternion in half floats
+};
+
+// how mesh attributes are stored on the GPU (Phong decodes both)
+enum class VertexFormat {
+  Float,   // 32 bit floats as the geometry fills them
+  Compact, // positions int16 in the bounding box (8 bytes), normals
+           // octahedral in 2 x int16 (4 bytes), uvs half floats (4 bytes)
+};
+
+// the Compact encodings, positions decode as offset + scale * p
+void quantizePositions(std::vector<float> const &positions,
+                       std::uint16_t dimensions,
+                       std::vector<std::int16_t> &encoded, vec3f &offset,
+                       vec3f &scale);
+void octahedralNormals(std::vector<float> const &normals,
+                       std::uint16_t dimensions,
+                       std::vector<std::int16_t> &encoded);
+void halfFloats(std::vector<float> const &values,
+                std::vector<std::uint16_t> &encoded);
+// moves and uniformly scales positions into [-1, 1], returns the transform
+// back
+mat4f normalizeMesh(std::vector<float> &positions, std::uint16_t dimensions);
+
+GLsizei instanceStride(InstanceLayout layout);
+// declares model through the POSE_MODEL hook, empty for Mat4
+std::string instanceModelSource(InstanceLayout layout);
+// attributes 0 to 3 of the bound vao from the bound GL_ARRAY_BUFFER,
+// starting at instance firstInstance
+void setInstanceAttributes(InstanceLayout layout, GLuint firstInstance = 0);
+// the compact layouts assume no shear and uniform scale (reflections are
+// kept as a negative scale)
+void encodeInstances(InstanceLayout layout, std::vector<mat4f> const &models,
+                     std::vector<std::uint8_t> &encoded);
+
 template <typename GeometryT, typename StyleT> struct InstancedRenderContext {
   std::unique_ptr<Program> shaderProgram;
   std::unique_ptr<VertexArray> vao;
 
   std::vector<mat4f> modelTransforms;
   std::unique_ptr<Buffer> modelTransformsBuffer;
+  InstanceLayout instanceLayout = InstanceLayout::Mat4;
+  std::vector<std::uint8_t> encodedInstances; // modelTransforms, packed
+
+  VertexFormat vertexFormat = VertexFormat::Float;
+  vec3f positionOffset{0.f}; // Compact positions
+  vec3f positionScale{1.f};
 
   // Keep references to the GL_ARRAY_BUFFERS so that
   // the stay in scope for this context.
-  std::vector<std::unique_ptr<Buffer>> arrayBuffers;
+  std::vector<std::shared_ptr<Buffer>> arrayBuffers;
+  std::shared_ptr<SharedBuffers> sharedBuffers; // see adoptSharedBuffers
 
   GLuint numberOfIndices;
   GLuint startIndex;
   GLuint vertexCount;
+  GLenum indexType = GL_UNSIGNED_INT; // see uploadIndices
 
   PrimitiveType primitive;
 
   typename StyleT::Parameters params;
+  bool geometryStage = false; // the program has one (see Phong)
+  bool barycentrics = false;  // the buffers carry them (location 8)
+  bool flatNormals = false;   // the buffers' normals are per face
+
+  // label for GPU timers
+  std::string name = "drawInstanced";
 
   // Default ctor/dtor & move operations
   InstancedRenderContext() = default;
@@ -16665,14 +17119,43 @@ template <typename GeometryT, typename StyleT> struct InstancedRenderContext {
   InstancedRenderContext(const InstancedRenderContext &) = delete;
   InstancedRenderContext &operator=(const InstancedRenderContext &) = delete;
 
-  std::string getModelSource() { return "layout(location=0) in "; }
+  std::string getModelSource() {
+    if (instanceLayout != InstanceLayout::Mat4)
+      return instanceModelSource(instanceLayout);
+    return "layout(location=0) in ";
+  }
 };
 
+template <typename GeometryT, typename StyleT>
+void setVertexFormatUniforms(InstancedRenderContext<GeometryT, StyleT> &ctx) {
+  if (ctx.vertexFormat == VertexFormat::Compact) {
+    ctx.shaderProgram->setVec3("positionOffset", ctx.positionOffset);
+    ctx.shaderProgram->setVec3("positionScale", ctx.positionScale);
+  }
+}
+
+// modelTransforms into the instance buffer, left bound to GL_ARRAY_BUFFER
+template <typename GeometryT, typename StyleT>
+void uploadInstances(InstancedRenderContext<GeometryT, StyleT> &ctx) {
+  ctx.modelTransformsBuffer->bind(GL_ARRAY_BUFFER);
+  if (ctx.instanceLayout == InstanceLayout::Mat4) {
+    ctx.modelTransformsBuffer->data(GL_ARRAY_BUFFER,
+                                    gsl::span<mat4f>(ctx.modelTransforms),
+                                    GL_DYNAMIC_DRAW);
+  } else {
+    encodeInstances(ctx.instanceLayout, ctx.modelTransforms,
+                    ctx.encodedInstances);
+    ctx.modelTransformsBuffer->data(GL_ARRAY_BUFFER, ctx.encodedInstances,
+                                    GL_DYNAMIC_DRAW);
+  }
+}
+
 template <typename GeometryT, typename StyleT, typename ViewContextT>
 void drawInstanced(
     InstancedRenderContext<GeometryT, StyleT> &ctx, ViewContextT const &viewCtx,
     std::function<void(std::unique_ptr<Program> const &)> setUniforms) {
-  ctx.shaderProgram->use();
+  GpuTimerScope gpuTimer(ctx.name);
+  glState().useProgram(*ctx.shaderProgram);
 
   mat4f view = viewCtx.camera.viewMatrix();
   mat4f projection = viewCtx.projection.projectionMatrix();
@@ -16682,17 +17165,18 @@ void drawInstanced(
   ctx.shaderProgram->setMat4("view", view);
   ctx.shaderProgram->setMat4("projection", projection);
   setUniforms(ctx.shaderProgram);
+  setVertexFormatUniforms(ctx);
 
-  ctx.vao->bind();
-  glPolygonMode(GL_FRONT, GL_FILL);
+  glState().bindVertexArray(*ctx.vao);
+  glState().polygonMode(GL_FRONT, GL_FILL);
   GLenum mode = givr::getMode(ctx.primitive);
-  ctx.modelTransformsBuffer->bind(GL_ARRAY_BUFFER);
-  ctx.modelTransformsBuffer->data(
-      GL_ARRAY_BUFFER, gsl::span<mat4f>(ctx.modelTransforms), GL_DYNAMIC_DRAW);
+  uploadInstances(ctx);
+  ++renderStats().drawCalls;
+  renderStats().instances += ctx.modelTransforms.size();
 
   if constexpr (hasIndices<GeometryT>::value) {
     if (ctx.numberOfIndices > 0) {
-      glDrawElementsInstanced(mode, ctx.numberOfIndices, GL_UNSIGNED_INT, 0,
+      glDrawElementsInstanced(mode, ctx.numberOfIndices, ctx.indexType, 0,
                               ctx.modelTransforms.size());
     } else {
       glDrawArraysInstanced(mode, ctx.startIndex, ctx.vertexCount,
@@ -16703,8 +17187,6 @@ void drawInstanced(
                           ctx.modelTransforms.size());
   }
 
-  ctx.vao->unbind();
-
   ctx.modelTransforms.clear();
 }
 
@@ -16719,15 +17201,11 @@ void allocateBuffers(InstancedRenderContext<GeometryT, StyleT> &ctx) {
 
   if constexpr (hasIndices<GeometryT>::value) {
     // Map - but don't upload indices data
-    std::unique_ptr<Buffer> indices = std::make_unique<Buffer>();
-    indices->alloc();
-    ctx.arrayBuffers.push_back(std::move(indices));
+    ctx.arrayBuffers.push_back(std::make_shared<Buffer>());
   }
 
   auto allocateBuffer = [&ctx]() {
-    std::unique_ptr<Buffer> vbo = std::make_unique<Buffer>();
-    vbo->alloc();
-    ctx.arrayBuffers.push_back(std::move(vbo));
+    ctx.arrayBuffers.push_back(std::make_shared<Buffer>());
   };
 
   // Upload / bind / map model data
@@ -16743,52 +17221,42 @@ void allocateBuffers(InstancedRenderContext<GeometryT, StyleT> &ctx) {
   if constexpr (hasColours<GeometryT>::value) {
     allocateBuffer(); // data.colours);
   }
+  if constexpr (isTriangleBased<GeometryT>()) {
+    allocateBuffer(); // data.barycentrics);
+  }
 }
 
+// geometry attributes from vaIndex on (after the per instance attributes),
+// expects the vao bound and leaves it unbound
 template <typename GeometryT, typename StyleT>
-void uploadBuffers(InstancedRenderContext<GeometryT, StyleT> &ctx,
-                   typename GeometryT::Data const &data) {
-  // Start by setting the appropriate context variables for rendering.
-  if constexpr (hasIndices<GeometryT>::value) {
-    ctx.numberOfIndices = data.indices.size();
-  } else {
-    ctx.numberOfIndices = 0;
-  }
-  ctx.startIndex = 0;
-  ctx.vertexCount = data.vertices.size() / data.dimensions;
-
-  std::uint16_t vaIndex = 0;
-  ctx.vao->bind();
-
-  // Upload framing data.
-  ctx.modelTransformsBuffer->bind(GL_ARRAY_BUFFER);
-  auto vec4Size = sizeof(mat4f) / 4;
-  for (std::uint16_t i = 0; i < 4; ++i) {
-    glVertexAttribPointer(vaIndex, 4, GL_FLOAT, GL_FALSE, sizeof(mat4f),
-                          (GLvoid *)(i * vec4Size));
-    glEnableVertexAttribArray(vaIndex);
-    glVertexAttribDivisor(vaIndex, 1);
-    ++vaIndex;
-  }
+void uploadGeometryBuffers(InstancedRenderContext<GeometryT, StyleT> &ctx,
+                           typename GeometryT::Data const &data,
+                           std::uint16_t vaIndex) {
+  // another renderable may have uploaded this data already
+  bool compact = ctx.vertexFormat == VertexFormat::Compact;
+  bool fresh = adoptSharedBuffers(ctx, data, compact ? "|compact" : "");
 
   std::uint16_t bufferIndex = 0;
   if constexpr (hasIndices<GeometryT>::value) {
-    std::unique_ptr<Buffer> &indices = ctx.arrayBuffers[0];
+    auto &indices = ctx.arrayBuffers[0];
     indices->bind(GL_ELEMENT_ARRAY_BUFFER);
-    indices->data(GL_ELEMENT_ARRAY_BUFFER, data.indices,
-                  getBufferUsageType(data.indicesType));
+    if (fresh) {
+      ctx.indexType = uploadIndices(*indices, data.indices,
+                                    getBufferUsageType(data.indicesType));
+    }
     ++bufferIndex;
   }
 
-  auto applyBuffer = [&ctx, &vaIndex, &bufferIndex](
+  auto applyBuffer = [&ctx, &vaIndex, &bufferIndex, fresh](
                          GLenum type, GLuint size, GLenum bufferType,
                          std::string name, gsl::span<const float> const &data) {
-    std::unique_ptr<Buffer> &vbo = ctx.arrayBuffers[bufferIndex];
+    auto &vbo = ctx.arrayBuffers[bufferIndex];
     vbo->bind(type);
     if (data.size() == 0) {
       glDisableVertexAttribArray(vaIndex);
     } else {
-      vbo->data(type, data, bufferType);
+      if (fresh)
+        vbo->data(type, data, bufferType);
       glBindAttribLocation(*ctx.shaderProgram.get(), vaIndex, name.c_str());
       glVertexAttribPointer(vaIndex, size, GL_FLOAT, GL_FALSE, 0, (GLvoid *)0);
       glEnableVertexAttribArray(vaIndex);
@@ -16797,28 +17265,119 @@ void uploadBuffers(InstancedRenderContext<GeometryT, StyleT> &ctx,
     ++bufferIndex;
   };
 
+  // integer attributes are normalized, so they arrive in [-1, 1]; encode
+  // uploads into the bound buffer and only runs for fresh buffers
+  auto applyEncoded = [&ctx, &vaIndex, &bufferIndex, fresh](
+                          GLuint size, GLenum type, GLsizei stride,
+                          bool present, auto const &encode) {
+    auto &vbo = ctx.arrayBuffers[bufferIndex];
+    vbo->bind(GL_ARRAY_BUFFER);
+    if (!present) {
+      glDisableVertexAttribArray(vaIndex);
+    } else {
+      if (fresh)
+        encode(*vbo);
+      glVertexAttribPointer(vaIndex, size, type, type != GL_HALF_FLOAT,
+                            stride, (GLvoid *)0);
+      glEnableVertexAttribArray(vaIndex);
+    }
+    ++vaIndex;
+    ++bufferIndex;
+  };
+
   // Upload / bind / map model data
-  if constexpr (hasVertices<GeometryT>::value)
-    applyBuffer(GL_ARRAY_BUFFER, data.dimensions,
-                getBufferUsageType(data.verticesType), "position",
-                data.vertices);
-  if constexpr (hasNormals<GeometryT>::value)
-    applyBuffer(GL_ARRAY_BUFFER, data.dimensions,
-                getBufferUsageType(data.normalsType), "normals", data.normals);
-  if constexpr (hasUvs<GeometryT>::value)
-    applyBuffer(GL_ARRAY_BUFFER, 2, getBufferUsageType(data.uvsType), "uvs",
-                data.uvs);
+  if (compact) {
+    if constexpr (hasVertices<GeometryT>::value) {
+      applyEncoded(3, GL_SHORT, 4 * sizeof(std::int16_t),
+                   !data.vertices.empty(), [&](Buffer &vbo) {
+                     std::vector<std::int16_t> positions;
+                     quantizePositions(data.vertices, data.dimensions,
+                                       positions, ctx.positionOffset,
+                                       ctx.positionScale);
+                     vbo.data(GL_ARRAY_BUFFER, positions,
+                              getBufferUsageType(data.verticesType));
+                   });
+    }
+    if constexpr (hasNormals<GeometryT>::value) {
+      applyEncoded(2, GL_SHORT, 0, !data.normals.empty(), [&](Buffer &vbo) {
+        std::vector<std::int16_t> normals;
+        octahedralNormals(data.normals, data.dimensions, normals);
+        vbo.data(GL_ARRAY_BUFFER, normals,
+                 getBufferUsageType(data.normalsType));
+      });
+    }
+    if constexpr (hasUvs<GeometryT>::value) {
+      applyEncoded(2, GL_HALF_FLOAT, 0, !data.uvs.empty(), [&](Buffer &vbo) {
+        std::vector<std::uint16_t> uvs;
+        halfFloats(data.uvs, uvs);
+        vbo.data(GL_ARRAY_BUFFER, uvs, getBufferUsageType(data.uvsType));
+      });
+    }
+  } else {
+    if constexpr (hasVertices<GeometryT>::value)
+      applyBuffer(GL_ARRAY_BUFFER, data.dimensions,
+                  getBufferUsageType(data.verticesType), "position",
+                  data.vertices);
+    if constexpr (hasNormals<GeometryT>::value)
+      applyBuffer(GL_ARRAY_BUFFER, data.dimensions,
+                  getBufferUsageType(data.normalsType), "normals",
+                  data.normals);
+    if constexpr (hasUvs<GeometryT>::value)
+      applyBuffer(GL_ARRAY_BUFFER, 2, getBufferUsageType(data.uvsType), "uvs",
+                  data.uvs);
+  }
   if constexpr (hasColours<GeometryT>::value)
     applyBuffer(GL_ARRAY_BUFFER, 3, getBufferUsageType(data.coloursType),
                 "colour", data.colours);
+  if constexpr (isTriangleBased<GeometryT>()) {
+    vaIndex = 8;
+    applyBuffer(GL_ARRAY_BUFFER, 3, GL_STATIC_DRAW, "barycentric",
+                data.barycentrics);
+  }
+  ctx.barycentrics = !data.barycentrics.empty();
+  ctx.flatNormals = data.flatNormals;
 
   ctx.vao->unbind();
 
+  if (ctx.sharedBuffers) {
+    auto &shared = *ctx.sharedBuffers;
+    if (fresh) {
+      shared.indexType = ctx.indexType;
+      shared.positionOffset = ctx.positionOffset;
+      shared.positionScale = ctx.positionScale;
+    } else {
+      ctx.indexType = shared.indexType;
+      ctx.positionOffset = shared.positionOffset;
+      ctx.positionScale = shared.positionScale;
+    }
+  }
+
   ctx.arrayBuffers[0]->unbind(GL_ELEMENT_ARRAY_BUFFER);
   if (ctx.arrayBuffers.size() > 1) {
     ctx.arrayBuffers[1]->unbind(GL_ARRAY_BUFFER);
   }
 }
+
+template <typename GeometryT, typename StyleT>
+void uploadBuffers(InstancedRenderContext<GeometryT, StyleT> &ctx,
+                   typename GeometryT::Data const &data) {
+  // Start by setting the appropriate context variables for rendering.
+  if constexpr (hasIndices<GeometryT>::value) {
+    ctx.numberOfIndices = data.indices.size();
+  } else {
+    ctx.numberOfIndices = 0;
+  }
+  ctx.startIndex = 0;
+  ctx.vertexCount = data.vertices.size() / data.dimensions;
+
+  ctx.vao->bind();
+
+  // Upload framing data.
+  ctx.modelTransformsBuffer->bind(GL_ARRAY_BUFFER);
+  setInstanceAttributes(ctx.instanceLayout);
+
+  uploadGeometryBuffers(ctx, data, 4);
+}
 }; // end namespace givr
 //------------------------------------------------------------------------------
 // END instanced_renderer.h
@@ -16955,8 +17514,10 @@ MultiLine::Data generateGeometry(MultiLine const &l);
 namespace givr {
 template <typename GeometryT, typename StyleT>
 InstancedRenderContext<GeometryT, StyleT>
-createInstancedRenderable(GeometryT const &g, StyleT const &style) {
-  auto ctx = getInstancedContext(g, style);
+createInstancedRenderable(GeometryT const &g, StyleT const &style,
+                          InstanceLayout layout = InstanceLayout::Mat4,
+                          VertexFormat format = VertexFormat::Float) {
+  auto ctx = getInstancedContext(g, style, layout, format);
   allocateBuffers(ctx);
   uploadBuffers(ctx, fillBuffers(g, style));
   return ctx;
@@ -17071,8 +17632,8 @@ void updateStyle(RenderContextT &ctx, GL_Line const &l) {
 template <typename GeometryT, typename ViewContextT>
 void draw(InstancedRenderContext<GeometryT, GL_Line> &ctx,
           ViewContextT const &viewCtx) {
-  glEnable(GL_LINE_SMOOTH);
-  glLineWidth(ctx.params.template value<Width>());
+  glState().enable(GL_LINE_SMOOTH);
+  glState().lineWidth(ctx.params.template value<Width>());
   drawInstanced(ctx, viewCtx, [&ctx](std::unique_ptr<Program> const &program) {
     setLineUniforms(ctx, program);
   });
@@ -17081,8 +17642,8 @@ void draw(InstancedRenderContext<GeometryT, GL_Line> &ctx,
 template <typename GeometryT, typename ViewContextT>
 void draw(RenderContext<GeometryT, GL_Line> &ctx, ViewContextT const &viewCtx,
           mat4f model = mat4f(1.f)) {
-  glEnable(GL_LINE_SMOOTH);
-  glLineWidth(ctx.params.template value<Width>());
+  glState().enable(GL_LINE_SMOOTH);
+  glState().lineWidth(ctx.params.template value<Width>());
   drawArray(ctx, viewCtx,
             [&ctx, &model](std::unique_ptr<Program> const &program) {
               setLineUniforms(ctx, program);
@@ -17192,7 +17753,10 @@ void draw(RenderContext<GeometryT, NoShading> &ctx, ViewContextT const &viewCtx,
 // Start phong.h
 //------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <numeric>
 #include <string>
+#include <vector>
 
 namespace givr {
 namespace style {
@@ -17237,20 +17801,158 @@ template <typename ColorSrc> struct T_Phong : T_PhongParameters<ColorSrc> {
 };
 
 std::string phongVertexSource(std::string modelSource, bool usingTexture,
-                              bool hasNormals, bool hasColours);
+                              bool hasNormals, bool hasColours,
+                              bool compactVertices, bool geometryStage);
 std::string phongGeometrySource(bool usingTexture, bool hasNormals,
                                 bool hasColours);
 std::string phongFragmentSource(bool usingTexture, bool hasColours);
 
-template <typename RenderContextT>
-void setPhongUniforms(RenderContextT const &ctx,
-                      std::unique_ptr<givr::Program> const &p) {
+// What fillBuffers builds into the buffers for these parameters: flat
+// normals for GenerateNormals and barycentric coordinates for
+// ShowWireFrame, both of which need every triangle to have its own
+// vertices. Only separate triangles are prepared. Flat normals replace the
+// mesh's own, so switching GenerateNormals off again takes an
+// updateRenderable.
+struct PhongPreparation {
+  bool wireFrame = false;
+  bool flatNormals = false;
+};
+
+template <typename GeometryT, typename ParametersT>
+PhongPreparation phongPreparation(ParametersT const &params) {
   using namespace givr::style;
-  if constexpr (std::is_same<RenderContextT, T_Phong<ColorTexture>>::value) {
-    givr::Texture texture = ctx.template value<ColorTexture>();
-    if (GLuint(texture)) {
-      glActiveTexture(GL_TEXTURE1);
-      texture.bind(GL_TEXTURE_2D);
+  PhongPreparation prepared;
+  if constexpr (getPrimitive<GeometryT>() == PrimitiveType::TRIANGLES) {
+    prepared.wireFrame = params.template value<ShowWireFrame>();
+    prepared.flatNormals = hasNormals<GeometryT>::value &&
+                           params.template value<GenerateNormals>();
+  }
+  return prepared;
+}
+
+// The geometry shader is the fallback for what the buffers do not carry:
+// flat normals for geometry without normals, and GenerateNormals or
+// ShowWireFrame switched on after the buffers were filled (until the next
+// updateRenderable). Otherwise the program is only a vertex and a fragment
+// shader. The choice is made at draw time (see selectPhongProgram).
+template <typename GeometryT, typename ContextT>
+bool usesPhongGeometryStage(ContextT const &ctx) {
+  using namespace givr::style;
+  return !hasNormals<GeometryT>::value ||
+         (ctx.params.template value<ShowWireFrame>() && !ctx.barycentrics) ||
+         (ctx.params.template value<GenerateNormals>() && !ctx.flatNormals);
+}
+
+// Un-indexes the triangles only when one of the parameters asks for it.
+// Mesh data that came without normals gets smooth ones (area weighted face
+// normals summed where triangles share a vertex), instead of shading with a
+// zero normal.
+template <typename GeometryT>
+void preparePhongGeometry(typename GeometryT::Data &data,
+                          PhongPreparation prepared) {
+  if constexpr (getPrimitive<GeometryT>() == PrimitiveType::TRIANGLES) {
+    auto dimensions = size_t(data.dimensions);
+    std::vector<std::uint32_t> corners;
+    if constexpr (hasIndices<GeometryT>::value) {
+      corners.assign(std::begin(data.indices), std::end(data.indices));
+    }
+    if (corners.empty()) {
+      corners.resize(data.vertices.size() / dimensions);
+      std::iota(std::begin(corners), std::end(corners), 0u);
+    }
+
+    // area weighted, summed where triangles share a vertex
+    auto faceNormals = [&]() {
+      if constexpr (hasNormals<GeometryT>::value) {
+        auto position = [&](std::uint32_t vertex) {
+          auto const *p = &data.vertices[vertex * dimensions];
+          return vec3f{p[0], p[1], dimensions > 2 ? p[2] : 0.f};
+        };
+        data.normals.assign(data.vertices.size(), 0.f);
+        for (size_t corner = 0; corner + 2 < corners.size(); corner += 3) {
+          auto a = position(corners[corner]);
+          auto normal = glm::cross(position(corners[corner + 1]) - a,
+                                   position(corners[corner + 2]) - a);
+          for (size_t i = 0; i < 3; ++i) {
+            auto *n = &data.normals[corners[corner + i] * dimensions];
+            for (size_t axis = 0; axis < std::min(dimensions, size_t(3));
+                 ++axis) {
+              n[axis] += normal[axis];
+            }
+          }
+        }
+      }
+    };
+
+    // the prepared data is shared by whoever prepares it the same way
+    auto tag = [&data](char const *preparation) {
+      if (!data.assetKey.empty())
+        data.assetKey += preparation;
+    };
+
+    if (!prepared.wireFrame && !prepared.flatNormals) {
+      if constexpr (hasNormals<GeometryT>::value) {
+        if (data.normals.empty()) {
+          faceNormals();
+          tag("|smooth");
+        }
+      }
+      return;
+    }
+
+    auto unshare = [&corners](std::vector<float> &values, size_t size) {
+      if (values.empty())
+        return;
+      std::vector<float> unshared;
+      unshared.reserve(corners.size() * size);
+      for (auto corner : corners) {
+        auto first = std::begin(values) + corner * size;
+        unshared.insert(std::end(unshared), first, first + size);
+      }
+      values = std::move(unshared);
+    };
+    if constexpr (hasNormals<GeometryT>::value) {
+      if (data.normals.empty() && !prepared.flatNormals) {
+        faceNormals();
+        tag("|smooth");
+      }
+      unshare(data.normals, dimensions);
+    }
+    unshare(data.vertices, dimensions);
+    if constexpr (hasUvs<GeometryT>::value)
+      unshare(data.uvs, 2);
+    if constexpr (hasColours<GeometryT>::value)
+      unshare(data.colours, 3);
+    std::iota(std::begin(corners), std::end(corners), 0u);
+    if constexpr (hasIndices<GeometryT>::value) {
+      if (!data.indices.empty())
+        data.indices = corners;
+    }
+
+    if (prepared.flatNormals) {
+      faceNormals();
+      data.flatNormals = true;
+      tag("|flat");
+    }
+    if (prepared.wireFrame) {
+      data.barycentrics.assign(corners.size() * 3, 0.f);
+      for (size_t corner = 0; corner < corners.size(); ++corner) {
+        data.barycentrics[corner * 3 + corner % 3] = 1.f;
+      }
+      tag("|wire");
+    }
+  }
+}
+
+template <typename RenderContextT>
+void setPhongUniforms(RenderContextT const &ctx,
+                      std::unique_ptr<givr::Program> const &p) {
+  using namespace givr::style;
+  if constexpr (std::is_same<RenderContextT, T_Phong<ColorTexture>>::value) {
+    givr::Texture texture = ctx.template value<ColorTexture>();
+    if (GLuint(texture)) {
+      glActiveTexture(GL_TEXTURE1);
+      texture.bind(GL_TEXTURE_2D);
       p->setInt("colorTexture", 1);
       glActiveTexture(GL_TEXTURE0);
     }
@@ -17270,7 +17972,7 @@ void setPhongUniforms(RenderContextT const &ctx,
 
 template <typename GeometryT, typename ColorSrc>
 typename GeometryT::Data fillBuffers(GeometryT const &g,
-                                     T_Phong<ColorSrc> const &) {
+                                     T_Phong<ColorSrc> const &style) {
   static_assert(
       givr::isTriangleBased<GeometryT>(),
       "The PhongStyle requires TRIANGLES, TRIANGLE_STRIP, TRIANGLE_FAN, "
@@ -17290,20 +17992,61 @@ typename GeometryT::Data fillBuffers(GeometryT const &g,
       "The Phong Texture style requires uvs. The geometry you are using does "
       "not provide them.");
 
-  return std::move(generateGeometry(g));
+  auto data = generateGeometry(g);
+  preparePhongGeometry<GeometryT>(data, phongPreparation<GeometryT>(style));
+  return data;
 }
 
 template <typename GeometryT, typename StyleT>
-std::unique_ptr<Program> getPhongShaderProgram(std::string modelSource) {
+std::unique_ptr<Program>
+getPhongShaderProgram(std::string modelSource, bool geometryStage,
+                      VertexFormat format = VertexFormat::Float) {
   constexpr bool _hasNormals = hasNormals<GeometryT>::value;
   constexpr bool _hasColours = hasColours<GeometryT>::value;
   constexpr bool _useTex = std::is_same<StyleT, T_Phong<ColorTexture>>::value;
+  bool compact = format == VertexFormat::Compact;
+  Shader vertex{phongVertexSource(modelSource, _useTex, _hasNormals,
+                                  _hasColours, compact, geometryStage),
+                GL_VERTEX_SHADER};
+  Shader fragment{phongFragmentSource(_useTex, _hasColours),
+                  GL_FRAGMENT_SHADER};
+  if (!geometryStage)
+    return std::make_unique<Program>(vertex, fragment);
   return std::make_unique<Program>(
-      Shader{phongVertexSource(modelSource, _useTex, _hasNormals, _hasColours),
-             GL_VERTEX_SHADER},
+      vertex,
       Shader{phongGeometrySource(_useTex, _hasNormals, _hasColours),
              GL_GEOMETRY_SHADER},
-      Shader{phongFragmentSource(_useTex, _hasColours), GL_FRAGMENT_SHADER});
+      fragment);
+}
+
+template <typename GeometryT, typename StyleT>
+VertexFormat phongVertexFormat(RenderContext<GeometryT, StyleT> const &) {
+  return VertexFormat::Float;
+}
+template <typename GeometryT, typename StyleT>
+VertexFormat
+phongVertexFormat(InstancedRenderContext<GeometryT, StyleT> const &ctx) {
+  return ctx.vertexFormat;
+}
+
+// a context whose buffers are not filled yet expects what fillBuffers
+// prepares for its parameters, so creating it builds the program it draws with
+template <typename GeometryT, typename ContextT>
+void expectPhongBuffers(ContextT &ctx) {
+  auto prepared = phongPreparation<GeometryT>(ctx.params);
+  ctx.barycentrics = prepared.wireFrame;
+  ctx.flatNormals = prepared.flatNormals;
+}
+
+// (re)builds the program when the parameters call for the other pipeline
+template <typename GeometryT, typename StyleT, typename ContextT>
+void selectPhongProgram(ContextT &ctx) {
+  bool geometryStage = usesPhongGeometryStage<GeometryT>(ctx);
+  if (ctx.shaderProgram && geometryStage == ctx.geometryStage)
+    return;
+  ctx.shaderProgram = getPhongShaderProgram<GeometryT, StyleT>(
+      ctx.getModelSource(), geometryStage, phongVertexFormat(ctx));
+  ctx.geometryStage = geometryStage;
 }
 
 template <typename GeometryT, typename ColorSrc>
@@ -17311,21 +18054,25 @@ RenderContext<GeometryT, T_Phong<ColorSrc>>
 getContext(GeometryT const &, T_Phong<ColorSrc> const &p) {
   std::cout << "Phong" << std::endl;
   RenderContext<GeometryT, T_Phong<ColorSrc>> ctx;
-  ctx.shaderProgram =
-      getPhongShaderProgram<GeometryT, T_Phong<ColorSrc>>(ctx.getModelSource());
   ctx.primitive = getPrimitive<GeometryT>();
   updateStyle(ctx, p);
+  expectPhongBuffers<GeometryT>(ctx);
+  selectPhongProgram<GeometryT, T_Phong<ColorSrc>>(ctx);
   return std::move(ctx);
 }
 
 template <typename GeometryT, typename StyleT>
-InstancedRenderContext<GeometryT, StyleT> getInstancedContext(GeometryT const &,
-                                                              StyleT const &p) {
+InstancedRenderContext<GeometryT, StyleT>
+getInstancedContext(GeometryT const &, StyleT const &p,
+                    InstanceLayout layout = InstanceLayout::Mat4,
+                    VertexFormat format = VertexFormat::Float) {
   InstancedRenderContext<GeometryT, StyleT> ctx;
-  ctx.shaderProgram =
-      getPhongShaderProgram<GeometryT, StyleT>(ctx.getModelSource());
+  ctx.instanceLayout = layout;
+  ctx.vertexFormat = format;
   ctx.primitive = getPrimitive<GeometryT>();
   updateStyle(ctx, p);
+  expectPhongBuffers<GeometryT>(ctx);
+  selectPhongProgram<GeometryT, StyleT>(ctx);
   return std::move(ctx);
 }
 
@@ -17334,14 +18081,26 @@ void updateStyle(RenderContextT &ctx, T_Phong<ColorSrc> const &p) {
   ctx.params.set(p.args);
 }
 
+// RenderQueue keys a draw on the program it is drawn with
+template <typename GeometryT, typename ColorSrc>
+void prepareDraw(InstancedRenderContext<GeometryT, T_Phong<ColorSrc>> &ctx) {
+  selectPhongProgram<GeometryT, T_Phong<ColorSrc>>(ctx);
+}
+
+template <typename GeometryT, typename ColorSrc>
+void prepareDraw(RenderContext<GeometryT, T_Phong<ColorSrc>> &ctx) {
+  selectPhongProgram<GeometryT, T_Phong<ColorSrc>>(ctx);
+}
+
 // TODO: come up with a better way to not duplicate OpenGL state setup
 template <typename GeometryT, typename ViewContextT, typename ColorSrc>
 void draw(InstancedRenderContext<GeometryT, T_Phong<ColorSrc>> &ctx,
           ViewContextT const &viewCtx) {
-  glEnable(GL_MULTISAMPLE);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  selectPhongProgram<GeometryT, T_Phong<ColorSrc>>(ctx);
+  glState().enable(GL_MULTISAMPLE);
+  glState().enable(GL_DEPTH_TEST);
+  glState().enable(GL_BLEND);
+  glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   drawInstanced(ctx, viewCtx, [&ctx](std::unique_ptr<Program> const &program) {
     setPhongUniforms(ctx, program);
   });
@@ -17350,10 +18109,11 @@ void draw(InstancedRenderContext<GeometryT, T_Phong<ColorSrc>> &ctx,
 template <typename GeometryT, typename ViewContextT, typename ColorSrc>
 void draw(RenderContext<GeometryT, T_Phong<ColorSrc>> &ctx,
           ViewContextT const &viewCtx, mat4f const model = mat4f(1.f)) {
-  glEnable(GL_MULTISAMPLE);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  selectPhongProgram<GeometryT, T_Phong<ColorSrc>>(ctx);
+  glState().enable(GL_MULTISAMPLE);
+  glState().enable(GL_DEPTH_TEST);
+  glState().enable(GL_BLEND);
+  glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   drawArray(ctx, viewCtx,
             [&ctx, &model](std::unique_ptr<Program> const &program) {
               setPhongUniforms(ctx, program);
@@ -17372,3 +18132,677 @@ using Phong = T_Phong<Colour>;
 //------------------------------------------------------------------------------
 // END phong.h
 //------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start track_instanced_renderer.h
+//------------------------------------------------------------------------------
+//
+// Instances posed on the GPU: each instance is only its arc length s and a
+// lift along the track's up axis (vec2, 8 bytes instead of a 64 byte mat4).
+// The vertex shader fetches the two track frames around s from a frame
+// table (a texture buffer of mat4 frames every frameSpacing) and blends
+// them, so the CPU work per instance is a push_back.
+//
+// auto carts = createTrackInstancedRenderable(mesh, phongStyle);
+// setFrameTable(carts, frames, spacing);  // when the track changes
+// addInstance(carts, s, lift);            // every frame
+// draw(carts, view);
+//
+#include <vector>
+
+namespace givr {
+
+template <typename GeometryT, typename StyleT>
+struct TrackInstancedRenderContext : InstancedRenderContext<GeometryT, StyleT> {
+  std::vector<vec2f> trackInstances; // s, lift
+
+  std::unique_ptr<Buffer> frameTableBuffer;
+  std::unique_ptr<Texture> frameTableTexture;
+  GLint frameCount = 0;
+  float frameSpacing = 1.f;
+
+  // defines model in the Phong vertex shader (see POSE_MODEL)
+  std::string getModelSource() {
+    return R"shader(
+        #define POSE_MODEL
+        layout(location=0) in vec2 trackInstance;
+        uniform samplerBuffer frameTable;
+        uniform float frameSpacing;
+        uniform int frameCount;
+
+        mat4 frameAt(int i) {
+            i = i % frameCount;
+            return mat4(texelFetch(frameTable, 4 * i),
+                        texelFetch(frameTable, 4 * i + 1),
+                        texelFetch(frameTable, 4 * i + 2),
+                        texelFetch(frameTable, 4 * i + 3));
+        }
+
+        // columns are side, up, tangent and position as built by
+        // utils::calculateMatrixOfPoint
+        mat4 poseModel() {
+            float x = mod(trackInstance.x / frameSpacing, float(frameCount));
+            int i = int(x);
+            float t = x - float(i);
+            mat4 a = frameAt(i);
+            mat4 b = frameAt(i + 1);
+            vec3 tangent = normalize(mix(a[2].xyz, b[2].xyz, t));
+            vec3 side = normalize(cross(tangent, mix(a[1].xyz, b[1].xyz, t)));
+            vec3 up = cross(side, tangent);
+            vec3 position = mix(a[3].xyz, b[3].xyz, t) + trackInstance.y * up;
+            return mat4(vec4(side, 0.0), vec4(up, 0.0), vec4(tangent, 0.0),
+                        vec4(position, 1.0));
+        }
+        )shader";
+  }
+};
+
+template <typename GeometryT, typename StyleT>
+void allocateBuffers(TrackInstancedRenderContext<GeometryT, StyleT> &ctx) {
+  allocateBuffers(
+      static_cast<InstancedRenderContext<GeometryT, StyleT> &>(ctx));
+  ctx.frameTableBuffer = std::make_unique<Buffer>();
+  ctx.frameTableBuffer->alloc();
+  ctx.frameTableTexture = std::make_unique<Texture>();
+}
+
+template <typename GeometryT, typename StyleT>
+void uploadBuffers(TrackInstancedRenderContext<GeometryT, StyleT> &ctx,
+                   typename GeometryT::Data const &data) {
+  if constexpr (hasIndices<GeometryT>::value) {
+    ctx.numberOfIndices = data.indices.size();
+  } else {
+    ctx.numberOfIndices = 0;
+  }
+  ctx.startIndex = 0;
+  ctx.vertexCount = data.vertices.size() / data.dimensions;
+
+  ctx.vao->bind();
+
+  // s and lift, the geometry keeps the locations after a mat4
+  ctx.modelTransformsBuffer->bind(GL_ARRAY_BUFFER);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vec2f), (GLvoid *)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribDivisor(0, 1);
+  for (GLuint unused = 1; unused < 4; ++unused) {
+    glDisableVertexAttribArray(unused);
+  }
+
+  uploadGeometryBuffers(ctx, data, 4);
+}
+
+template <typename GeometryT, typename StyleT>
+TrackInstancedRenderContext<GeometryT, StyleT>
+createTrackInstancedRenderable(GeometryT const &g, StyleT const &style,
+                               VertexFormat format = VertexFormat::Float) {
+  TrackInstancedRenderContext<GeometryT, StyleT> ctx;
+  ctx.vertexFormat = format;
+  ctx.primitive = getPrimitive<GeometryT>();
+  updateStyle(ctx, style);
+  style::expectPhongBuffers<GeometryT>(ctx);
+  style::selectPhongProgram<GeometryT, StyleT>(ctx);
+  allocateBuffers(ctx);
+  uploadBuffers(ctx, fillBuffers(g, style));
+  return ctx;
+}
+
+template <typename GeometryT, typename StyleT>
+void updateRenderable(GeometryT const &g, StyleT const &style,
+                      TrackInstancedRenderContext<GeometryT, StyleT> &ctx) {
+  updateStyle(ctx, style);
+  uploadBuffers(ctx, fillBuffers(g, style));
+}
+
+// frames[i] is the track frame at arc length i * spacing. The table wraps
+// at frames.size() * spacing, which should be the track's length (s outside
+// it, negative included, is wrapped onto the track).
+template <typename GeometryT, typename StyleT>
+void setFrameTable(TrackInstancedRenderContext<GeometryT, StyleT> &ctx,
+                   std::vector<mat4f> const &frames, float spacing) {
+  // a frame is 4 texels, longer tables keep the nearest of fewer frames
+  // spread over the same length
+  GLint maxTexels = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+  size_t maxFrames = size_t(std::max(maxTexels, 4)) / 4;
+  std::vector<mat4f> fitted;
+  if (frames.size() > maxFrames) {
+    fitted.reserve(maxFrames);
+    for (size_t i = 0; i < maxFrames; ++i) {
+      fitted.push_back(frames[i * frames.size() / maxFrames]);
+    }
+    spacing *= float(frames.size()) / float(maxFrames);
+  }
+  auto const &table = fitted.empty() ? frames : fitted;
+
+  ctx.frameTableBuffer->bind(GL_TEXTURE_BUFFER);
+  ctx.frameTableBuffer->data(GL_TEXTURE_BUFFER, table, GL_STATIC_DRAW);
+  ctx.frameTableBuffer->unbind(GL_TEXTURE_BUFFER);
+  ctx.frameTableTexture->bind(GL_TEXTURE_BUFFER);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, *ctx.frameTableBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  ctx.frameCount = GLint(table.size());
+  ctx.frameSpacing = spacing;
+}
+
+template <typename GeometryT, typename StyleT>
+void addInstance(TrackInstancedRenderContext<GeometryT, StyleT> &ctx,
+                 float s, float lift = 0.f) {
+  ctx.trackInstances.emplace_back(s, lift);
+}
+
+template <typename GeometryT, typename StyleT, typename ViewContextT>
+void drawTrackInstanced(
+    TrackInstancedRenderContext<GeometryT, StyleT> &ctx,
+    ViewContextT const &viewCtx,
+    std::function<void(std::unique_ptr<Program> const &)> setUniforms) {
+  if (ctx.frameCount == 0 || ctx.trackInstances.empty()) {
+    ctx.trackInstances.clear();
+    return;
+  }
+  GpuTimerScope gpuTimer(ctx.name);
+  glState().useProgram(*ctx.shaderProgram);
+
+  ctx.shaderProgram->setVec3("viewPosition", viewCtx.camera.viewPosition());
+  ctx.shaderProgram->setMat4("view", viewCtx.camera.viewMatrix());
+  ctx.shaderProgram->setMat4("projection",
+                             viewCtx.projection.projectionMatrix());
+  setUniforms(ctx.shaderProgram);
+  setVertexFormatUniforms(ctx);
+
+  // unit 1 belongs to colorTexture
+  glActiveTexture(GL_TEXTURE2);
+  ctx.frameTableTexture->bind(GL_TEXTURE_BUFFER);
+  ctx.shaderProgram->setInt("frameTable", 2);
+  ctx.shaderProgram->setInt("frameCount", ctx.frameCount);
+  ctx.shaderProgram->setFloat("frameSpacing", ctx.frameSpacing);
+  glActiveTexture(GL_TEXTURE0);
+
+  glState().bindVertexArray(*ctx.vao);
+  glState().polygonMode(GL_FRONT, GL_FILL);
+  GLenum mode = givr::getMode(ctx.primitive);
+  ctx.modelTransformsBuffer->bind(GL_ARRAY_BUFFER);
+  ctx.modelTransformsBuffer->data(GL_ARRAY_BUFFER, ctx.trackInstances,
+                                  GL_DYNAMIC_DRAW);
+  ++renderStats().drawCalls;
+  renderStats().instances += ctx.trackInstances.size();
+
+  if (ctx.numberOfIndices > 0) {
+    glDrawElementsInstanced(mode, ctx.numberOfIndices, ctx.indexType, 0,
+                            ctx.trackInstances.size());
+  } else {
+    glDrawArraysInstanced(mode, ctx.startIndex, ctx.vertexCount,
+                          ctx.trackInstances.size());
+  }
+
+  ctx.trackInstances.clear();
+}
+
+template <typename GeometryT, typename ColorSrc>
+void prepareDraw(
+    TrackInstancedRenderContext<GeometryT, style::T_Phong<ColorSrc>> &ctx) {
+  style::selectPhongProgram<GeometryT, style::T_Phong<ColorSrc>>(ctx);
+}
+
+template <typename GeometryT, typename ViewContextT, typename ColorSrc>
+void draw(TrackInstancedRenderContext<GeometryT, style::T_Phong<ColorSrc>> &ctx,
+          ViewContextT const &viewCtx) {
+  style::selectPhongProgram<GeometryT, style::T_Phong<ColorSrc>>(ctx);
+  glState().enable(GL_MULTISAMPLE);
+  glState().enable(GL_DEPTH_TEST);
+  glState().enable(GL_BLEND);
+  glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  drawTrackInstanced(ctx, viewCtx,
+                     [&ctx](std::unique_ptr<Program> const &program) {
+                       style::setPhongUniforms(ctx, program);
+                     });
+}
+
+} // namespace givr
+//------------------------------------------------------------------------------
+// END track_instanced_renderer.h
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start multi_mesh_renderer.h
+//------------------------------------------------------------------------------
+//
+// Many distinct meshes with one style packed into shared vertex and index
+// buffers, each mesh a range of them. The frame's instances of all meshes
+// go out as one indirect command per mesh, submitted with a single
+// glMultiDrawElementsIndirect where GL 4.3 (or ARB_multi_draw_indirect and
+// ARB_base_instance) is available. Older contexts fall back to a draw per
+// mesh with the instance attributes offset to that mesh's instances.
+//
+// auto scenery = createMultiMeshRenderable(std::vector{tree, station}, style);
+// addInstance(scenery, 1, model);  // mesh index, every frame
+// draw(scenery, view);
+//
+#include <vector>
+
+namespace givr {
+
+// as glDrawElementsIndirect reads it
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+bool multiDrawIndirectSupported();
+
+template <typename GeometryT, typename StyleT>
+struct MultiMeshRenderContext : InstancedRenderContext<GeometryT, StyleT> {
+  struct MeshRange {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+    // Compact vertices: the mesh is scaled into the unit cube before the
+    // shared quantization and its instances are scaled back (uniformly, so
+    // the compact instance layouts still hold)
+    mat4f decode{1.f};
+  };
+  std::vector<MeshRange> meshes;
+
+  std::vector<std::vector<mat4f>> meshInstances; // per mesh, this frame
+  std::vector<DrawElementsIndirectCommand> commands;
+  std::unique_ptr<Buffer> indirectBuffer;
+};
+
+template <typename GeometryT, typename StyleT>
+void uploadBuffers(MultiMeshRenderContext<GeometryT, StyleT> &ctx,
+                   std::vector<GeometryT> const &meshes,
+                   StyleT const &style) {
+  static_assert(hasIndices<GeometryT>::value,
+                "Multi mesh renderables need indexed geometry");
+  typename GeometryT::Data packed;
+  ctx.meshes.clear();
+  for (auto const &mesh : meshes) {
+    auto data = fillBuffers(mesh, style);
+    auto previousVertices = packed.vertices.size() / packed.dimensions;
+    auto vertexCount = data.vertices.size() / data.dimensions;
+    ctx.meshes.push_back({GLuint(packed.indices.size()),
+                          GLuint(data.indices.size()),
+                          GLint(previousVertices)});
+    if (ctx.vertexFormat == VertexFormat::Compact) {
+      ctx.meshes.back().decode = normalizeMesh(data.vertices, data.dimensions);
+    }
+
+    // attributes only some meshes have are zero for the others, so every
+    // array stays one entry per vertex
+    auto append = [&](std::vector<float> &to, std::vector<float> const &from,
+                      size_t size) {
+      if (to.empty() && from.empty())
+        return;
+      to.resize(previousVertices * size);
+      to.insert(std::end(to), std::begin(from), std::end(from));
+      to.resize((previousVertices + vertexCount) * size);
+    };
+    append(packed.vertices, data.vertices, packed.dimensions);
+    if constexpr (hasNormals<GeometryT>::value)
+      append(packed.normals, data.normals, packed.dimensions);
+    if constexpr (hasUvs<GeometryT>::value)
+      append(packed.uvs, data.uvs, 2);
+    if constexpr (hasColours<GeometryT>::value)
+      append(packed.colours, data.colours, 3);
+    append(packed.barycentrics, data.barycentrics, 3);
+    packed.flatNormals = data.flatNormals; // one style prepares every mesh
+    packed.indices.insert(std::end(packed.indices), std::begin(data.indices),
+                          std::end(data.indices));
+  }
+  ctx.meshInstances.resize(ctx.meshes.size());
+  uploadBuffers(static_cast<InstancedRenderContext<GeometryT, StyleT> &>(ctx),
+                packed);
+}
+
+template <typename GeometryT, typename StyleT>
+MultiMeshRenderContext<GeometryT, StyleT>
+createMultiMeshRenderable(std::vector<GeometryT> const &meshes,
+                          StyleT const &style,
+                          InstanceLayout layout = InstanceLayout::Mat4,
+                          VertexFormat format = VertexFormat::Float) {
+  MultiMeshRenderContext<GeometryT, StyleT> ctx;
+  ctx.instanceLayout = layout;
+  ctx.vertexFormat = format;
+  ctx.primitive = getPrimitive<GeometryT>();
+  updateStyle(ctx, style);
+  style::expectPhongBuffers<GeometryT>(ctx);
+  style::selectPhongProgram<GeometryT, StyleT>(ctx);
+  allocateBuffers(
+      static_cast<InstancedRenderContext<GeometryT, StyleT> &>(ctx));
+  ctx.indirectBuffer = std::make_unique<Buffer>();
+  uploadBuffers(ctx, meshes, style);
+  return ctx;
+}
+
+// the meshes keep their indices, instances added since the last draw are
+// kept
+template <typename GeometryT, typename StyleT>
+void updateRenderable(std::vector<GeometryT> const &meshes,
+                      StyleT const &style,
+                      MultiMeshRenderContext<GeometryT, StyleT> &ctx) {
+  updateStyle(ctx, style);
+  uploadBuffers(ctx, meshes, style);
+}
+
+template <typename GeometryT, typename StyleT>
+void addInstance(MultiMeshRenderContext<GeometryT, StyleT> &ctx,
+                 size_t mesh, mat4f const &model) {
+  ctx.meshInstances.at(mesh).push_back(model);
+}
+
+template <typename GeometryT, typename StyleT, typename ViewContextT>
+void drawMultiMesh(
+    MultiMeshRenderContext<GeometryT, StyleT> &ctx,
+    ViewContextT const &viewCtx,
+    std::function<void(std::unique_ptr<Program> const &)> setUniforms) {
+  // instances grouped by mesh, a command's baseInstance is where its group
+  // starts in the instance buffer
+  ctx.modelTransforms.clear();
+  ctx.commands.clear();
+  for (size_t mesh = 0; mesh < ctx.meshes.size(); ++mesh) {
+    auto &instances = ctx.meshInstances[mesh];
+    if (instances.empty())
+      continue;
+    auto const &range = ctx.meshes[mesh];
+    ctx.commands.push_back({range.indexCount, GLuint(instances.size()),
+                            range.firstIndex, range.baseVertex,
+                            GLuint(ctx.modelTransforms.size())});
+    for (auto const &model : instances) {
+      ctx.modelTransforms.push_back(model * range.decode);
+    }
+    instances.clear();
+  }
+  if (ctx.commands.empty())
+    return;
+
+  GpuTimerScope gpuTimer(ctx.name);
+  glState().useProgram(*ctx.shaderProgram);
+
+  mat4f view = viewCtx.camera.viewMatrix();
+  mat4f projection = viewCtx.projection.projectionMatrix();
+  vec3f viewPosition = viewCtx.camera.viewPosition();
+
+  ctx.shaderProgram->setVec3("viewPosition", viewPosition);
+  ctx.shaderProgram->setMat4("view", view);
+  ctx.shaderProgram->setMat4("projection", projection);
+  setUniforms(ctx.shaderProgram);
+  setVertexFormatUniforms(ctx);
+
+  glState().bindVertexArray(*ctx.vao);
+  glState().polygonMode(GL_FRONT, GL_FILL);
+  GLenum mode = givr::getMode(ctx.primitive);
+  uploadInstances(ctx);
+  renderStats().instances += ctx.modelTransforms.size();
+
+  if (multiDrawIndirectSupported()) {
+    ++renderStats().drawCalls;
+    ctx.indirectBuffer->bind(GL_DRAW_INDIRECT_BUFFER);
+    ctx.indirectBuffer->data(GL_DRAW_INDIRECT_BUFFER, ctx.commands,
+                             GL_DYNAMIC_DRAW);
+    glMultiDrawElementsIndirect(mode, ctx.indexType, nullptr,
+                                GLsizei(ctx.commands.size()), 0);
+    ctx.indirectBuffer->unbind(GL_DRAW_INDIRECT_BUFFER);
+  } else {
+    for (auto const &command : ctx.commands) {
+      ++renderStats().drawCalls;
+      setInstanceAttributes(ctx.instanceLayout, command.baseInstance);
+      glDrawElementsInstancedBaseVertex(
+          mode, command.count, ctx.indexType,
+          (GLvoid *)(std::size_t(command.firstIndex) *
+                     indexSize(ctx.indexType)),
+          command.instanceCount, command.baseVertex);
+    }
+  }
+
+  ctx.modelTransforms.clear();
+}
+
+template <typename GeometryT, typename ColorSrc>
+void prepareDraw(
+    MultiMeshRenderContext<GeometryT, style::T_Phong<ColorSrc>> &ctx) {
+  style::selectPhongProgram<GeometryT, style::T_Phong<ColorSrc>>(ctx);
+}
+
+template <typename GeometryT, typename ViewContextT, typename ColorSrc>
+void draw(MultiMeshRenderContext<GeometryT, style::T_Phong<ColorSrc>> &ctx,
+          ViewContextT const &viewCtx) {
+  style::selectPhongProgram<GeometryT, style::T_Phong<ColorSrc>>(ctx);
+  glState().enable(GL_MULTISAMPLE);
+  glState().enable(GL_DEPTH_TEST);
+  glState().enable(GL_BLEND);
+  glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  drawMultiMesh(ctx, viewCtx,
+                [&ctx](std::unique_ptr<Program> const &program) {
+                  style::setPhongUniforms(ctx, program);
+                });
+}
+
+} // namespace givr
+//------------------------------------------------------------------------------
+// END multi_mesh_renderer.h
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Start render_queue.h
+//------------------------------------------------------------------------------
+//
+// Draws submitted during the frame and issued together, ordered by a 64 bit
+// sort key so draws sharing a program, then buffers, run back to back and
+// GLState can skip the rebinds:
+//
+//   opaque, overlay: pass (4) | program (16) | mesh (16) | material (16)
+//   transparent:     pass (4) | view depth, far to near (32)
+//
+// program is the Program's variant (see Program::variant), mesh the
+// renderable's first buffer, which renderables sharing an asset's buffers
+// share (see AssetRegistry), and material a hash of the style parameters.
+// Submitting brings the renderable's program up to date first (see
+// prepareDraw), so the key is the one it draws with. Blended draws go far
+// to near by the depth of their model, or the centre of their instances.
+// Draws with equal keys keep their submission order.
+//
+// Instanced renderables of the same type that share their program variant,
+// buffers, parameters and instance layout are merged outside the
+// transparent pass: the first takes the others' instances and draws them
+// all at once. A renderable submitted twice merges with itself.
+//
+// RenderQueue queue;
+// queue.submit(spheres, view);
+// queue.submit(ground, view, model);
+// queue.execute();  // while view is still alive
+//
+#include <cstdint>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace givr {
+
+enum class RenderPass : std::uint8_t { Opaque = 0, Transparent = 1, Overlay = 2 };
+
+template <typename ContextT, typename = void>
+struct isInstancedContext : std::false_type {};
+template <typename ContextT>
+struct isInstancedContext<ContextT,
+                          std::void_t<decltype(&ContextT::instanceLayout)>>
+    : std::true_type {};
+
+// only plain instanced renderables merge, the derived ones pose or group
+// their instances themselves
+template <typename ContextT>
+struct isMergeableContext : std::false_type {};
+template <typename GeometryT, typename StyleT>
+struct isMergeableContext<InstancedRenderContext<GeometryT, StyleT>>
+    : std::true_type {};
+
+// an address per context type, submissions only merge within one
+template <typename ContextT> inline char const contextTypeTag = 0;
+
+// brings the program ctx draws with up to date before it is keyed, styles
+// that choose their program at draw time overload it (see Phong)
+template <typename ContextT> void prepareDraw(ContextT &) {}
+
+// sorts entries by key, stable, so equal keys keep their submission order
+struct SortEntry {
+  std::uint64_t key;
+  std::uint32_t index;
+};
+void radixSort(std::vector<SortEntry> &entries,
+               std::vector<SortEntry> &scratch);
+
+std::uint64_t renderSortKey(RenderPass pass, std::uint16_t program,
+                            GLuint mesh, std::uint64_t material, float depth);
+
+inline std::uint64_t hashParameter(std::uint64_t hash, Texture const &value) {
+  return (hash ^ GLuint(value)) * 0x100000001b3ull;
+}
+template <typename T>
+std::uint64_t hashParameter(std::uint64_t hash, T const &value) {
+  auto const *bytes = reinterpret_cast<unsigned char const *>(&value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+inline bool sameParameter(Texture const &a, Texture const &b) {
+  return GLuint(a) == GLuint(b);
+}
+template <typename T> bool sameParameter(T const &a, T const &b) {
+  return a == b;
+}
+
+// style parameters are float, bool, vec3f or Texture values
+template <typename ParametersT>
+std::uint64_t materialHash(ParametersT const &params) {
+  return std::apply(
+      [](auto const &... values) {
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        ((hash = hashParameter(hash, values.value())), ...);
+        return hash;
+      },
+      params.args);
+}
+
+template <typename ParametersT>
+bool sameMaterial(ParametersT const &a, ParametersT const &b) {
+  return std::apply(
+      [&b](auto const &... values) {
+        return (sameParameter(values.value(),
+                              b.template value<std::decay_t<decltype(values)>>()
+                                  .value()) &&
+                ...);
+      },
+      a.args);
+}
+
+// where a blended renderable is, for its depth
+template <typename ContextT> vec3f submissionCentre(ContextT const &ctx) {
+  vec3f centre{0.f};
+  if constexpr (isMergeableContext<ContextT>::value) {
+    for (auto const &model : ctx.modelTransforms) {
+      centre += vec3f(model[3]) / float(ctx.modelTransforms.size());
+    }
+  }
+  return centre;
+}
+
+template <typename GeometryT, typename StyleT>
+bool mergeInstances(InstancedRenderContext<GeometryT, StyleT> &into,
+                    InstancedRenderContext<GeometryT, StyleT> &from) {
+  if (&into == &from)
+    return true; // its first draw takes all its instances
+  if (!into.sharedBuffers || into.sharedBuffers != from.sharedBuffers ||
+      into.shaderProgram->variant() != from.shaderProgram->variant() ||
+      into.instanceLayout != from.instanceLayout ||
+      into.vertexFormat != from.vertexFormat ||
+      !sameMaterial(into.params, from.params)) {
+    return false;
+  }
+  into.modelTransforms.insert(std::end(into.modelTransforms),
+                              std::begin(from.modelTransforms),
+                              std::end(from.modelTransforms));
+  from.modelTransforms.clear();
+  return true;
+}
+
+class RenderQueue {
+public:
+  template <typename ContextT, typename ViewContextT>
+  void submit(ContextT &ctx, ViewContextT const &viewCtx,
+              RenderPass pass = RenderPass::Opaque) {
+    prepareDraw(ctx);
+    push(key(ctx, viewCtx, submissionCentre(ctx), pass), pass, &ctx,
+         &contextTypeTag<ContextT>, mergeFor(ctx),
+         [&ctx, &viewCtx]() { draw(ctx, viewCtx); });
+  }
+
+  template <typename GeometryT, typename StyleT, typename ViewContextT>
+  void submit(RenderContext<GeometryT, StyleT> &ctx,
+              ViewContextT const &viewCtx, mat4f const &model,
+              RenderPass pass = RenderPass::Opaque) {
+    prepareDraw(ctx);
+    push(key(ctx, viewCtx, vec3f(model[3]), pass), pass, &ctx,
+         &contextTypeTag<RenderContext<GeometryT, StyleT>>, {},
+         [&ctx, &viewCtx, model]() { draw(ctx, viewCtx, model); });
+  }
+
+  // sorts, draws and empties the queue
+  void execute();
+
+  size_t size() const { return m_submissions.size(); }
+  bool empty() const { return m_submissions.empty(); }
+
+private:
+  struct Submission {
+    std::uint64_t key;
+    RenderPass pass;
+    void *context;
+    void const *type; // see contextTypeTag
+    // takes another submission's instances, false if they do not fit; empty
+    // for renderables that never merge
+    std::function<bool(void *)> merge;
+    std::function<void()> draw;
+    bool merged = false;
+  };
+
+  template <typename ContextT, typename ViewContextT>
+  static std::uint64_t key(ContextT const &ctx, ViewContextT const &viewCtx,
+                           vec3f const &centre, RenderPass pass) {
+    GLuint mesh = ctx.arrayBuffers.empty() ? GLuint(*ctx.vao)
+                                           : GLuint(*ctx.arrayBuffers.front());
+    vec4f view = viewCtx.camera.viewMatrix() * vec4f(centre, 1.f);
+    return renderSortKey(pass, ctx.shaderProgram->variant(), mesh,
+                         materialHash(ctx.params), -view.z);
+  }
+
+  template <typename ContextT>
+  static std::function<bool(void *)> mergeFor(ContextT &ctx) {
+    if constexpr (isMergeableContext<ContextT>::value) {
+      return [&ctx](void *other) {
+        return mergeInstances(ctx, *static_cast<ContextT *>(other));
+      };
+    } else if constexpr (isInstancedContext<ContextT>::value) {
+      // its first draw takes all its instances
+      return [&ctx](void *other) { return other == &ctx; };
+    } else {
+      return {};
+    }
+  }
+
+  void push(std::uint64_t key, RenderPass pass, void *context,
+            void const *type, std::function<bool(void *)> merge,
+            std::function<void()> draw);
+
+  std::vector<Submission> m_submissions;
+  std::vector<SortEntry> m_order;
+  std::vector<SortEntry> m_scratch;
+};
+
+} // namespace givr
+//------------------------------------------------------------------------------
+// END render_queue.h
+//------------------------------------------------------------------------------
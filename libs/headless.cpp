@@ -0,0 +1,259 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <utility>
+
+#if GIVIO_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace giv {
+namespace io {
+
+//
+// Headless window
+//
+HeadlessWindow::HeadlessWindow(Properties properties, size_t frameLimit)
+    : m_properties(std::move(properties)), m_frameLimit(frameLimit) {
+  m_frameMilliseconds.reserve(frameLimit);
+
+  glGenRenderbuffers(1, &m_colour);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_colour);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width(), height());
+
+  glGenRenderbuffers(1, &m_depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width(),
+                        height());
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &m_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, m_colour);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, m_depth);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Headless framebuffer is incomplete\n";
+  }
+}
+
+HeadlessWindow::~HeadlessWindow() { release(); }
+
+HeadlessWindow::HeadlessWindow(HeadlessWindow &&other) noexcept
+    : m_frameLimit(0) {
+  *this = std::move(other);
+}
+
+HeadlessWindow &HeadlessWindow::operator=(HeadlessWindow &&other) noexcept {
+  if (this != &other) {
+    release();
+    m_properties = std::move(other.m_properties);
+    m_frameLimit = other.m_frameLimit;
+    m_frames = other.m_frames;
+    m_framebuffer = std::exchange(other.m_framebuffer, 0);
+    m_colour = std::exchange(other.m_colour, 0);
+    m_depth = std::exchange(other.m_depth, 0);
+    m_keyboardCommands = std::move(other.m_keyboardCommands);
+    m_frameStart = other.m_frameStart;
+    m_frameMilliseconds = std::move(other.m_frameMilliseconds);
+  }
+  return *this;
+}
+
+uint32_t HeadlessWindow::width() const { return m_properties.width(); }
+
+uint32_t HeadlessWindow::height() const { return m_properties.height(); }
+
+KeyboardCommands &HeadlessWindow::keyboardCommands() {
+  return m_keyboardCommands;
+}
+
+bool HeadlessWindow::shouldClose() const { return m_frames >= m_frameLimit; }
+
+size_t HeadlessWindow::framesRendered() const { return m_frames; }
+
+void HeadlessWindow::beginFrame() {
+  m_frameStart = clock::now();
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glViewport(0, 0, width(), height());
+}
+
+void HeadlessWindow::endFrame() {
+  // nothing presents the frame, wait for it so frame times include the GPU
+  glFinish();
+  m_frameMilliseconds.push_back(
+      std::chrono::duration<double, std::milli>(clock::now() - m_frameStart)
+          .count());
+  ++m_frames;
+}
+
+GLuint HeadlessWindow::framebuffer() const { return m_framebuffer; }
+
+void HeadlessWindow::printReport(std::ostream &out) const {
+  // the first frames include shader compilation and first uploads
+  size_t warmUp = std::min<size_t>(5, m_frameMilliseconds.size() / 10);
+  std::vector<double> times(std::begin(m_frameMilliseconds) + warmUp,
+                            std::end(m_frameMilliseconds));
+  if (times.empty()) {
+    out << "headless: no frames rendered\n";
+    return;
+  }
+
+  std::sort(std::begin(times), std::end(times));
+  double total = std::accumulate(std::begin(times), std::end(times), 0.0);
+  double mean = total / times.size();
+  auto percentile = [&](double p) {
+    return times[std::min(times.size() - 1, size_t(p * times.size()))];
+  };
+
+  out << std::fixed << std::setprecision(2) << "headless: " << times.size()
+      << " frames at " << width() << 'x' << height() << " (" << warmUp
+      << " warm-up frames skipped)\n"
+      << "  " << 1000.0 / mean << " frames/sec, " << mean << " ms/frame\n"
+      << "  min " << times.front() << " ms, p50 " << percentile(0.5)
+      << " ms, p95 " << percentile(0.95) << " ms, max " << times.back()
+      << " ms\n";
+}
+
+void HeadlessWindow::release() {
+  if (m_framebuffer) {
+    glDeleteFramebuffers(1, &m_framebuffer);
+  }
+  if (m_colour) {
+    glDeleteRenderbuffers(1, &m_colour);
+  }
+  if (m_depth) {
+    glDeleteRenderbuffers(1, &m_depth);
+  }
+  m_framebuffer = m_colour = m_depth = 0;
+}
+
+//
+// Headless context
+//
+HeadlessContext::HeadlessContext() {
+#if GIVIO_HEADLESS
+  // prefer Mesa's surfaceless platform, it needs neither X nor a GPU
+  auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+      eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  EGLDisplay display = EGL_NO_DISPLAY;
+  if (getPlatformDisplay) {
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  EGLint major, minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    std::cerr << "Unable to initialize EGL\n";
+    return;
+  }
+  m_display = display;
+#else
+  std::cerr << "Built without EGL, headless rendering is unavailable\n";
+#endif
+}
+
+HeadlessContext::~HeadlessContext() {
+#if GIVIO_HEADLESS
+  if (m_display) {
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_context) {
+      eglDestroyContext(m_display, m_context);
+    }
+    eglTerminate(m_display);
+  }
+#endif
+}
+
+HeadlessContext &HeadlessContext::glMajorVesion(int version) {
+  m_majorVersion = version;
+  return *this;
+}
+
+HeadlessContext &HeadlessContext::glMinorVesion(int version) {
+  m_minorVersion = version;
+  return *this;
+}
+
+std::optional<HeadlessWindow>
+HeadlessContext::makeWindow(Properties properties, size_t frameLimit) {
+  if (!m_context && !createContext())
+    return std::nullopt;
+  return HeadlessWindow(std::move(properties), frameLimit);
+}
+
+bool HeadlessContext::isValid() const { return m_context != nullptr; }
+
+std::string HeadlessContext::rendererString() const {
+  if (!isValid())
+    return "none";
+  return std::string(reinterpret_cast<char const *>(glGetString(GL_RENDERER))) +
+         ", OpenGL " +
+         reinterpret_cast<char const *>(glGetString(GL_VERSION));
+}
+
+bool HeadlessContext::createContext() {
+#if GIVIO_HEADLESS
+  if (!m_display)
+    return false;
+
+  eglBindAPI(EGL_OPENGL_API);
+
+  // surfaceless contexts render to FBOs only, any config (or none) will do
+  EGLint const configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                     EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint configCount = 0;
+  eglChooseConfig(m_display, configAttributes, &config, 1, &configCount);
+
+  EGLint const contextAttributes[] = {
+      EGL_CONTEXT_MAJOR_VERSION,        m_majorVersion,
+      EGL_CONTEXT_MINOR_VERSION,        m_minorVersion,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK,  EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE};
+  EGLContext context =
+      eglCreateContext(m_display, configCount > 0 ? config : EGL_NO_CONFIG_KHR,
+                       EGL_NO_CONTEXT, contextAttributes);
+  if (context == EGL_NO_CONTEXT) {
+    std::cerr << "Unable to create an OpenGL " << m_majorVersion << '.'
+              << m_minorVersion << " core context through EGL\n";
+    return false;
+  }
+  if (!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    std::cerr << "EGL_KHR_surfaceless_context is not supported\n";
+    eglDestroyContext(m_display, context);
+    return false;
+  }
+
+  m_context = context;
+  gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+  return true;
+#else
+  return false;
+#endif
+}
+
+//
+// main loop hooks
+//
+bool shouldClose(HeadlessWindow const &window) { return window.shouldClose(); }
+
+void preRender(HeadlessWindow &window) { window.beginFrame(); }
+
+void postRender(HeadlessWindow &window) {
+  PROFILE_ZONE("postRender");
+  givr::GpuTimers::instance().endFrame();
+  recordFrameCounters();
+  window.endFrame();
+}
+
+} // namespace io
+} // namespace giv
@@ -0,0 +1,104 @@
+#pragma once
+
+// Offscreen rendering without a display server.
+//
+// HeadlessContext creates an OpenGL context through EGL on Mesa's
+// surfaceless platform (llvmpipe on machines without a GPU), HeadlessWindow
+// renders into a framebuffer object of a fixed size. HeadlessWindow can be
+// passed to mainloop in place of a Window: it renders a fixed number of
+// frames and keeps per-frame timings for a benchmark report.
+//
+// Needs EGL at build time (GIVIO_HEADLESS=1), otherwise HeadlessContext is
+// never valid.
+
+#include "givio.h"
+
+#include <chrono>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace giv {
+namespace io {
+
+class HeadlessWindow final {
+public:
+  HeadlessWindow(Properties properties, size_t frameLimit);
+  ~HeadlessWindow();
+
+  HeadlessWindow(HeadlessWindow &&other) noexcept;
+  HeadlessWindow &operator=(HeadlessWindow &&other) noexcept;
+
+  HeadlessWindow(HeadlessWindow const &) = delete;
+  HeadlessWindow &operator=(HeadlessWindow const &) = delete;
+
+  uint32_t width() const;
+  uint32_t height() const;
+
+  // never triggered, lets key bindings be shared with windowed code
+  KeyboardCommands &keyboardCommands();
+
+  // true once frameLimit frames have been rendered
+  bool shouldClose() const;
+  size_t framesRendered() const;
+
+  void beginFrame();
+  void endFrame();
+
+  GLuint framebuffer() const;
+
+  // frame rate and frame time distribution (after a short warm-up)
+  void printReport(std::ostream &out) const;
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  void release();
+
+  Properties m_properties;
+  size_t m_frameLimit;
+  size_t m_frames = 0;
+
+  GLuint m_framebuffer = 0;
+  GLuint m_colour = 0;
+  GLuint m_depth = 0;
+
+  KeyboardCommands m_keyboardCommands;
+  clock::time_point m_frameStart;
+  std::vector<double> m_frameMilliseconds;
+};
+
+class HeadlessContext final {
+public:
+  HeadlessContext();
+  ~HeadlessContext();
+
+  HeadlessContext(HeadlessContext const &) = delete;
+  HeadlessContext &operator=(HeadlessContext const &) = delete;
+
+  HeadlessContext &glMajorVesion(int version);
+  HeadlessContext &glMinorVesion(int version);
+
+  // creates the GL context on first use, empty if that fails
+  std::optional<HeadlessWindow> makeWindow(Properties properties,
+                                           size_t frameLimit);
+
+  bool isValid() const;
+  std::string rendererString() const;
+
+private:
+  bool createContext();
+
+  void *m_display = nullptr; // EGLDisplay
+  void *m_context = nullptr; // EGLContext
+  int m_majorVersion = 3;
+  int m_minorVersion = 3;
+};
+
+bool shouldClose(HeadlessWindow const &window);
+void preRender(HeadlessWindow &window);
+void postRender(HeadlessWindow &window);
+
+} // namespace io
+} // namespace giv
@@ -1,6 +1,12 @@
 #include "panel.h"
 
+#include <algorithm>
 #include <array>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+#include "profiler.h"
 
 namespace panel {
 
@@ -14,13 +20,162 @@ int curveSamples = 200;
 // loading
 bool rereadControlPoints = false;
 std::string controlPointsFilePath = "./roller_coaster.obj";
+bool saveBinaryTrack = false;
 
 // animation
 bool play = false;
+float friction = 0.f;
+float drag = 0.f;
+bool speedSettingsChanged = false;
+bool speedSettingsSettled = false;
 
 // reset
 bool resetView = false;
 
+namespace {
+
+// bars for the last frames plus a flame graph (one row per nesting level and
+// thread) of the selected frame
+void profilerTimeline() {
+  using namespace ImGui;
+
+  if (!profiler::enabled) {
+    TextDisabled("Profiler compiled out (PROFILER=OFF)");
+    return;
+  }
+
+  constexpr int kHistory = 120;
+  static bool paused = false;
+  static int selected = 0;
+  static std::vector<profiler::FrameRange> frames;
+  static std::vector<float> frameTimes;
+
+  Checkbox("Pause", &paused);
+  if (!paused || frames.empty()) {
+    frames.clear();
+    frameTimes.clear();
+    auto count = std::min<size_t>(profiler::frameCount(), kHistory);
+    for (size_t i = count; i-- > 0;) { // oldest first
+      frames.push_back(profiler::frame(i));
+      frameTimes.push_back(float(frames.back().milliseconds()));
+    }
+  }
+  if (frames.empty())
+    return;
+
+  PlotHistogram("##frame times", frameTimes.data(), int(frameTimes.size()), 0,
+                "frame ms", 0.f, 33.f, ImVec2(-1.f, 60.f));
+  SliderInt("Frames ago", &selected, 0, int(frames.size()) - 1);
+  selected = std::min(selected, int(frames.size()) - 1);
+
+  auto range = frames[frames.size() - 1 - size_t(selected)];
+  auto zones = profiler::collect(range.begin, range.end);
+  Text("Frame %.3f ms, %zu zones", range.milliseconds(), zones.size());
+
+  // rows: every thread gets as many rows as its deepest zone
+  std::vector<std::uint32_t> rowsOfThread;
+  for (auto const &zone : zones) {
+    if (zone.thread >= rowsOfThread.size())
+      rowsOfThread.resize(zone.thread + 1, 0);
+    rowsOfThread[zone.thread] =
+        std::max(rowsOfThread[zone.thread], zone.depth + 1);
+  }
+  std::vector<std::uint32_t> firstRow(rowsOfThread.size(), 0);
+  std::uint32_t rows = 0;
+  for (size_t t = 0; t < rowsOfThread.size(); ++t) {
+    firstRow[t] = rows;
+    rows += rowsOfThread[t];
+  }
+
+  auto *drawList = GetWindowDrawList();
+  auto origin = GetCursorScreenPos();
+  float width = std::max(GetContentRegionAvail().x, 100.f);
+  float rowHeight = GetTextLineHeightWithSpacing();
+  double scale = width / double(std::max<std::uint64_t>(range.end - range.begin, 1));
+
+  for (auto const &zone : zones) {
+    auto begin = std::max(zone.begin, range.begin) - range.begin;
+    auto end = std::min(zone.end, range.end) - range.begin;
+    float y = origin.y + (firstRow[zone.thread] + zone.depth) * rowHeight;
+    ImVec2 min(origin.x + float(begin * scale), y);
+    ImVec2 max(std::max(origin.x + float(end * scale), min.x + 1.f),
+               y + rowHeight - 1.f);
+
+    // colour by name so a zone keeps its colour from frame to frame
+    auto hue = float(std::hash<std::string_view>()(zone.name) % 360) / 360.f;
+    drawList->AddRectFilled(min, max, ImColor::HSV(hue, 0.5f, 0.8f));
+    if (CalcTextSize(zone.name).x + 4.f < max.x - min.x) {
+      drawList->AddText(ImVec2(min.x + 2.f, min.y), IM_COL32_BLACK, zone.name);
+    }
+    if (IsMouseHoveringRect(min, max)) {
+      SetTooltip("%s: %.3f ms", zone.name, (zone.end - zone.begin) * 1e-6);
+    }
+  }
+  Dummy(ImVec2(width, std::max<std::uint32_t>(rows, 1) * rowHeight));
+}
+
+// GL_TIME_ELAPSED per renderable, a few frames behind the CPU
+void gpuTimings() {
+  using namespace ImGui;
+
+  auto &timers = givr::GpuTimers::instance();
+  if (!timers.supported()) {
+    TextDisabled("GPU timers need GL 3.3 or ARB_timer_query");
+    return;
+  }
+
+  bool enabled = timers.enabled();
+  if (Checkbox("GPU timers", &enabled)) {
+    timers.setEnabled(enabled);
+  }
+  if (!enabled)
+    return;
+
+  // renderables drawn more than once a frame are summed
+  std::vector<givr::GpuTimers::Sample> totals;
+  double frameTotal = 0.0;
+  for (auto const &sample : timers.lastFrame()) {
+    auto iter = std::find_if(
+        std::begin(totals), std::end(totals),
+        [&](auto const &total) { return total.name == sample.name; });
+    if (iter == std::end(totals)) {
+      totals.push_back(sample);
+    } else {
+      iter->milliseconds += sample.milliseconds;
+    }
+    frameTotal += sample.milliseconds;
+  }
+
+  Text("GPU %.3f ms", frameTotal);
+  for (auto const &total : totals) {
+    char overlay[64];
+    std::snprintf(overlay, sizeof(overlay), "%.3f ms", total.milliseconds);
+    ProgressBar(frameTotal > 0.0 ? float(total.milliseconds / frameTotal) : 0.f,
+                ImVec2(GetContentRegionAvail().x * 0.65f, 0.f), overlay);
+    SameLine(0.f, GetStyle().ItemInnerSpacing.x);
+    TextUnformatted(total.name.c_str());
+  }
+}
+
+// live GL objects and their storage, see givr::GLResources
+void gpuResources() {
+  using namespace ImGui;
+
+  auto const &resources = givr::glResources();
+  std::size_t totalBytes = 0;
+  for (std::size_t kind = 0; kind < givr::kGLResourceKinds; ++kind) {
+    auto live = resources.live(givr::GLResourceKind(kind));
+    Text("%-14s %6zu  %10.1f KiB",
+         givr::glResourceKindName(givr::GLResourceKind(kind)), live.count,
+         live.bytes / 1024.0);
+    totalBytes += live.bytes;
+  }
+  Text("%-14s %6s  %10.1f KiB", "total", "", totalBytes / 1024.0);
+  Text("%zu released, waiting for the GPU", resources.pending());
+}
+
+} // namespace
+
 void updateMenu() {
   using namespace ImGui;
 
@@ -53,11 +208,13 @@ void updateMenu() {
       // local string buffer
       static std::array<char, 64> buffer;
 
-      InputText("(OBJ) file", buffer.data(), buffer.size());
+      InputText("(OBJ/TRK) file", buffer.data(), buffer.size());
       rereadControlPoints = Button("Load");
       if (rereadControlPoints) {
         controlPointsFilePath = buffer.data();
       }
+      SameLine();
+      saveBinaryTrack = Button("Save binary (.trk)");
     }
 
     Spacing();
@@ -65,11 +222,24 @@ void updateMenu() {
     if (Button("Play/Pause")) {
       play = !play;
     }
+    speedSettingsChanged = SliderFloat("Friction", &friction, 0.f, 0.05f);
+    speedSettingsSettled = IsItemDeactivatedAfterEdit();
+    speedSettingsChanged |= SliderFloat("Drag", &drag, 0.f, 0.002f, "%.4f");
+    speedSettingsSettled |= IsItemDeactivatedAfterEdit();
 
     Spacing();
     Separator();
     resetView = Button("Reset view");
 
+    Spacing();
+    if (CollapsingHeader("Profiler")) {
+      profilerTimeline();
+      Separator();
+      gpuTimings();
+      Separator();
+      gpuResources();
+    }
+
     Spacing();
     Separator();
     Text("Application average %.3f ms/frame (%.1f FPS)",
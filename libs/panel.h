@@ -18,9 +18,14 @@ extern int curveSamples;
 // loading
 extern bool rereadControlPoints;
 extern std::string controlPointsFilePath;
+extern bool saveBinaryTrack;
 
 // animation
 extern bool play;
+extern float friction; // see modelling::SpeedTableSettings
+extern float drag;
+extern bool speedSettingsChanged; // every frame a slider moves
+extern bool speedSettingsSettled; // once, when the slider is let go
 
 // reset
 extern bool resetView;
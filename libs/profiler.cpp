@@ -0,0 +1,361 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace profiler {
+
+namespace {
+
+constexpr size_t kEventCapacity = 1 << 15; // per thread, power of two
+constexpr size_t kCounterCapacity = 1 << 13;
+constexpr size_t kFrameCapacity = 512;
+
+// Single producer ring. Slots are atomics (relaxed, so plain stores on x86)
+// which lets readers copy them while the owning thread keeps writing; a
+// reader drops whatever may have been overwritten while it was copying.
+struct ThreadBuffer {
+  struct Slot {
+    std::atomic<char const *> name{nullptr};
+    std::atomic<std::uint64_t> begin{0};
+    std::atomic<std::uint64_t> end{0};
+    std::atomic<std::uint32_t> depth{0};
+  };
+
+  struct CounterSlot {
+    std::atomic<char const *> track{nullptr};
+    std::atomic<std::uint32_t> series{0};
+    std::atomic<std::uint64_t> time{0};
+    std::atomic<double> value{0.0};
+  };
+
+  std::uint32_t thread = 0;
+  std::atomic<char const *> name{nullptr};
+
+  std::atomic<std::uint64_t> head{0};
+  std::array<Slot, kEventCapacity> slots;
+
+  std::atomic<std::uint64_t> counterHead{0};
+  std::array<CounterSlot, kCounterCapacity> counters;
+};
+
+struct Registry {
+  std::mutex mutex;
+  // buffers outlive their threads so readers never see them disappear
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  // interned counter series names
+  std::vector<std::string> series;
+  std::unordered_map<std::string, std::uint32_t> seriesIds;
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+ThreadBuffer &threadBuffer() {
+  thread_local ThreadBuffer *buffer = [] {
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.buffers.push_back(std::make_unique<ThreadBuffer>());
+    r.buffers.back()->thread = std::uint32_t(r.buffers.size() - 1);
+    return r.buffers.back().get();
+  }();
+  return *buffer;
+}
+
+thread_local std::uint32_t t_depth = 0;
+
+std::uint32_t internSeries(std::string_view name) {
+  // per thread cache so that only the first use of a name takes the lock,
+  // keyed by views of its own copies of the names so that a lookup doesn't
+  // allocate (the deque never moves them)
+  thread_local std::deque<std::string> names;
+  thread_local std::unordered_map<std::string_view, std::uint32_t> cache;
+  auto cached = cache.find(name);
+  if (cached != std::end(cache))
+    return cached->second;
+
+  std::string key(name);
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto iter = r.seriesIds.find(key);
+  if (iter == std::end(r.seriesIds)) {
+    iter = r.seriesIds.emplace(key, std::uint32_t(r.series.size())).first;
+    r.series.push_back(key);
+  }
+  names.push_back(std::move(key));
+  cache.emplace(names.back(), iter->second);
+  return iter->second;
+}
+
+// reads the slots [head - capacity, head) newest first, stopping as soon as
+// visit returns false or the writer may have lapped the slot being read
+template <size_t Capacity, typename Slots, typename Visit>
+void readRing(std::atomic<std::uint64_t> const &head, Slots const &slots,
+              Visit visit) {
+  auto last = head.load(std::memory_order_acquire);
+  auto first = last > Capacity ? last - Capacity : 0;
+  for (auto i = last; i-- > first;) {
+    auto const &slot = slots[i & (Capacity - 1)];
+    auto keepGoing = visit(slot, [&] {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return head.load(std::memory_order_relaxed) - i < Capacity;
+    });
+    if (!keepGoing)
+      break;
+  }
+}
+
+void writeJsonString(std::ostream &out, std::string_view text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+struct Frames {
+  std::atomic<std::uint64_t> count{0};
+  std::array<std::atomic<std::uint64_t>, kFrameCapacity> starts{};
+};
+
+Frames &frames() {
+  static Frames instance;
+  return instance;
+}
+
+} // namespace
+
+std::uint64_t now() {
+  using namespace std::chrono;
+  return std::uint64_t(
+      duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+          .count());
+}
+
+//
+// recording
+//
+
+Zone::Zone(char const *name) : m_name(name), m_begin(now()), m_depth(t_depth++) {}
+
+Zone::~Zone() {
+  auto end = now();
+  --t_depth;
+
+  auto &buffer = threadBuffer();
+  auto head = buffer.head.load(std::memory_order_relaxed);
+  auto &slot = buffer.slots[head & (kEventCapacity - 1)];
+  slot.name.store(m_name, std::memory_order_relaxed);
+  slot.begin.store(m_begin, std::memory_order_relaxed);
+  slot.end.store(end, std::memory_order_relaxed);
+  slot.depth.store(m_depth, std::memory_order_relaxed);
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void counter(char const *track, std::string_view series, double value) {
+  auto id = internSeries(series);
+
+  auto &buffer = threadBuffer();
+  auto head = buffer.counterHead.load(std::memory_order_relaxed);
+  auto &slot = buffer.counters[head & (kCounterCapacity - 1)];
+  slot.track.store(track, std::memory_order_relaxed);
+  slot.series.store(id, std::memory_order_relaxed);
+  slot.time.store(now(), std::memory_order_relaxed);
+  slot.value.store(value, std::memory_order_relaxed);
+  buffer.counterHead.store(head + 1, std::memory_order_release);
+}
+
+void setThreadName(char const *name) { threadBuffer().name.store(name); }
+
+void markFrame() {
+  auto &f = frames();
+  auto count = f.count.load(std::memory_order_relaxed);
+  f.starts[count % kFrameCapacity].store(now(), std::memory_order_relaxed);
+  f.count.store(count + 1, std::memory_order_release);
+}
+
+//
+// reading
+//
+
+size_t frameCount() {
+  auto count = frames().count.load(std::memory_order_acquire);
+  // a frame is complete once the next one has started
+  return count < 2 ? 0 : std::min<size_t>(count - 1, kFrameCapacity - 1);
+}
+
+FrameRange frame(size_t framesAgo) {
+  auto &f = frames();
+  auto count = f.count.load(std::memory_order_acquire);
+  if (framesAgo >= frameCount())
+    return {0, 0};
+
+  auto last = count - 1 - framesAgo; // start of the following frame
+  return {f.starts[(last - 1) % kFrameCapacity].load(std::memory_order_relaxed),
+          f.starts[last % kFrameCapacity].load(std::memory_order_relaxed)};
+}
+
+std::vector<ZoneEvent> collect(std::uint64_t begin, std::uint64_t end) {
+  std::vector<ZoneEvent> events;
+
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto const &buffer : r.buffers) {
+    // zones are recorded as they close, so ends only grow towards head
+    readRing<kEventCapacity>(
+        buffer->head, buffer->slots, [&](auto const &slot, auto valid) {
+          ZoneEvent event{slot.name.load(std::memory_order_relaxed),
+                          slot.begin.load(std::memory_order_relaxed),
+                          slot.end.load(std::memory_order_relaxed),
+                          slot.depth.load(std::memory_order_relaxed),
+                          buffer->thread};
+          if (!valid() || event.end <= begin)
+            return false;
+          if (event.begin < end) {
+            events.push_back(event);
+          }
+          return true;
+        });
+  }
+
+  std::sort(std::begin(events), std::end(events),
+            [](ZoneEvent const &a, ZoneEvent const &b) {
+              return a.begin < b.begin;
+            });
+  return events;
+}
+
+std::vector<CounterEvent> collectCounters(std::uint64_t begin,
+                                          std::uint64_t end) {
+  std::vector<CounterEvent> events;
+
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto const &buffer : r.buffers) {
+    readRing<kCounterCapacity>(
+        buffer->counterHead, buffer->counters,
+        [&](auto const &slot, auto valid) {
+          auto track = slot.track.load(std::memory_order_relaxed);
+          auto series = slot.series.load(std::memory_order_relaxed);
+          auto time = slot.time.load(std::memory_order_relaxed);
+          auto value = slot.value.load(std::memory_order_relaxed);
+          if (!valid() || time < begin)
+            return false;
+          if (time < end) {
+            events.push_back({track, r.series[series], time, value});
+          }
+          return true;
+        });
+  }
+
+  std::sort(std::begin(events), std::end(events),
+            [](CounterEvent const &a, CounterEvent const &b) {
+              return a.time < b.time;
+            });
+  return events;
+}
+
+//
+// export
+//
+
+bool writeChromeTrace(std::string const &filePath) {
+  auto zones = collect(0, ~std::uint64_t(0));
+  auto counters = collectCounters(0, ~std::uint64_t(0));
+  std::vector<FrameRange> frameRanges;
+  for (size_t i = frameCount(); i-- > 0;) {
+    frameRanges.push_back(frame(i));
+  }
+
+  std::vector<std::pair<std::uint32_t, char const *>> threads;
+  {
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto const &buffer : r.buffers) {
+      threads.emplace_back(buffer->thread, buffer->name.load());
+    }
+  }
+
+  std::ofstream out(filePath);
+  if (!out)
+    return false;
+
+  // timestamps are microseconds relative to the oldest event
+  auto origin = ~std::uint64_t(0);
+  for (auto const &zone : zones)
+    origin = std::min(origin, zone.begin);
+  for (auto const &sample : counters)
+    origin = std::min(origin, sample.time);
+  for (auto const &range : frameRanges)
+    origin = std::min(origin, range.begin);
+  auto micros = [&](std::uint64_t ns) { return (ns - origin) * 1e-3; };
+
+  constexpr std::uint32_t kFramesTrack = 0xffff;
+  char const *separator = "\n";
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  auto beginEvent = [&] {
+    out << separator;
+    separator = ",\n";
+  };
+
+  for (auto const &thread : threads) {
+    beginEvent();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << thread.first << ",\"args\":{\"name\":";
+    writeJsonString(out, thread.second
+                             ? thread.second
+                             : "thread " + std::to_string(thread.first));
+    out << "}}";
+  }
+  beginEvent();
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+      << kFramesTrack << ",\"args\":{\"name\":\"frames\"}}";
+
+  out.precision(3);
+  out << std::fixed;
+  for (auto const &range : frameRanges) {
+    beginEvent();
+    out << "{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,"
+        << "\"tid\":" << kFramesTrack << ",\"ts\":" << micros(range.begin)
+        << ",\"dur\":" << (range.end - range.begin) * 1e-3 << "}";
+  }
+  for (auto const &zone : zones) {
+    beginEvent();
+    out << "{\"name\":";
+    writeJsonString(out, zone.name);
+    out << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << zone.thread
+        << ",\"ts\":" << micros(zone.begin)
+        << ",\"dur\":" << (zone.end - zone.begin) * 1e-3 << "}";
+  }
+  for (auto const &sample : counters) {
+    beginEvent();
+    out << "{\"name\":";
+    writeJsonString(out, sample.track);
+    out << ",\"ph\":\"C\",\"pid\":1,\"ts\":" << micros(sample.time)
+        << ",\"args\":{";
+    writeJsonString(out, sample.series);
+    out << ":" << sample.value << "}}";
+  }
+  out << "\n]}\n";
+  return bool(out);
+}
+
+} // namespace profiler
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+// Scoped CPU zones
+//
+//   void update() {
+//     PROFILE_ZONE("update");
+//     ...
+//   }
+//
+// Every thread records into its own fixed size ring buffer, so recording a
+// zone is two clock reads and a store, without locks. Zone names must be
+// string literals (only the pointer is kept).
+//
+// Counters (PROFILE_COUNTER("render", "draw calls", n)) sample a value per
+// series over time and are recorded the same way.
+//
+// Configure with -DPROFILER=OFF to compile every macro down to nothing.
+//
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name)                                                     \
+  profiler::Zone PROFILER_CONCAT(profileZone_, __LINE__) { name }
+#define PROFILE_FRAME() profiler::markFrame()
+#define PROFILE_COUNTER(track, series, value)                                  \
+  profiler::counter(track, series, double(value))
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_COUNTER(track, series, value) ((void)0)
+#endif
+
+namespace profiler {
+
+struct ZoneEvent {
+  char const *name;
+  std::uint64_t begin; // ns, see now()
+  std::uint64_t end;
+  std::uint32_t depth;
+  std::uint32_t thread;
+};
+
+struct CounterEvent {
+  char const *track;
+  std::string series;
+  std::uint64_t time; // ns, see now()
+  double value;
+};
+
+struct FrameRange {
+  std::uint64_t begin;
+  std::uint64_t end;
+
+  double milliseconds() const { return (end - begin) * 1e-6; }
+};
+
+constexpr bool enabled = PROFILER_ENABLED;
+
+// nanoseconds on a steady clock
+std::uint64_t now();
+
+//
+// recording
+//
+class Zone {
+public:
+  explicit Zone(char const *name);
+  ~Zone();
+
+  Zone(Zone const &) = delete;
+  Zone &operator=(Zone const &) = delete;
+
+private:
+  char const *m_name;
+  std::uint64_t m_begin;
+  std::uint32_t m_depth;
+};
+
+void markFrame();
+
+// series names are copied (interned), track names must be literals
+void counter(char const *track, std::string_view series, double value);
+
+// name shown for the calling thread in exported traces
+void setThreadName(char const *name);
+
+//
+// reading (any thread)
+//
+
+// completed frames, 0 being the most recent one
+size_t frameCount();
+FrameRange frame(size_t framesAgo);
+
+// zones of every thread that overlap [begin, end), sorted by begin
+std::vector<ZoneEvent> collect(std::uint64_t begin, std::uint64_t end);
+
+// counter samples of every thread within [begin, end), sorted by time
+std::vector<CounterEvent> collectCounters(std::uint64_t begin,
+                                          std::uint64_t end);
+
+//
+// export
+//
+
+// Chrome Trace Event Format (chrome://tracing, ui.perfetto.dev) of all zones,
+// counters and frames still held in the ring buffers
+bool writeChromeTrace(std::string const &filePath);
+
+} // namespace profiler
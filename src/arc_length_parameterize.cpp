@@ -1,9 +1,12 @@
 #include "arc_length_parameterize.hpp"
 
+#include "profiler.h"
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/compatibility.hpp> // lerp
 
 #include <iostream>
+#include <utility>
 
 namespace modelling {
 
@@ -15,6 +18,9 @@ ArcLengthTable::ArcLengthTable(float deltaS) : m_delta_s(deltaS) {
 
 }
 
+ArcLengthTable::ArcLengthTable(float deltaS, table_t values)
+    : m_values(std::move(values)), m_delta_s(deltaS) {}
+
 float ArcLengthTable::nearestValueTo(float s) const {
   auto index = indexAt(s);
   if (index >= m_values.size()) {
@@ -79,6 +85,7 @@ ArcLengthTable calculateArcLengthTable(HermiteCurve const &curve, float delta_s,
   //
   // TODO (Students): calculate the arc-length parameterization...
   //
+  PROFILE_ZONE("calculateArcLengthTable");
   assert(delta_u > 0.f);
 	ArcLengthTable table(delta_s);
 	table.addNext(0);
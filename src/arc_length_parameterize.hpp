@@ -32,6 +32,7 @@ public: // types
 public: // interface
   ArcLengthTable() = default;
   explicit ArcLengthTable(float deltaS);
+  ArcLengthTable(float deltaS, table_t values);
 
   // accessors
   float nearestValueTo(float s) const;
@@ -0,0 +1,127 @@
+/**
+  Little-endian encoding helpers shared by the binary file formats
+  (see saveTrackBinary, StreamingTrackWriter and TrajectoryRecorder).
+  **/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace utils {
+
+using byte_t = unsigned char;
+
+inline bool hostIsLittleEndian() {
+  std::uint16_t probe = 1;
+  byte_t first;
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+// FNV-1a, pass the previous result as hash to continue a running hash
+inline std::uint64_t fnv1a(byte_t const *data, std::size_t size,
+                           std::uint64_t hash = 14695981039346656037ull) {
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+//
+// writing
+//
+template <typename T> void putLE(std::vector<byte_t> &out, T value) {
+  static_assert(std::is_unsigned<T>::value, "write the bit pattern");
+  for (std::size_t i = 0; i < sizeof(T); ++i) {
+    out.push_back(byte_t((value >> (8 * i)) & 0xff));
+  }
+}
+
+inline void putFloat(std::vector<byte_t> &out, float value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  putLE(out, bits);
+}
+
+inline void putFloats(std::vector<byte_t> &out, float const *values,
+                      std::size_t count) {
+  if (hostIsLittleEndian()) {
+    auto const *bytes = reinterpret_cast<byte_t const *>(values);
+    out.insert(std::end(out), bytes, bytes + count * sizeof(float));
+  } else {
+    for (std::size_t i = 0; i < count; ++i) {
+      putFloat(out, values[i]);
+    }
+  }
+}
+
+// zig-zag maps small negative numbers to small unsigned ones
+inline std::uint64_t zigZag(std::int64_t value) {
+  return (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63);
+}
+
+inline void putVarint(std::vector<byte_t> &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(byte_t(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(byte_t(value));
+}
+
+inline void padTo(std::vector<byte_t> &out, std::size_t alignment) {
+  while (out.size() % alignment != 0) {
+    out.push_back(0);
+  }
+}
+
+//
+// reading
+//
+template <typename T> T getLE(byte_t const *in) {
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); ++i) {
+    value |= T(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+inline std::int64_t unZigZag(std::uint64_t value) {
+  return std::int64_t(value >> 1) ^ -std::int64_t(value & 1);
+}
+
+// returns the byte after the varint, nullptr if it runs past end
+inline byte_t const *getVarint(byte_t const *in, byte_t const *end,
+                               std::uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+    byte_t b = *in++;
+    value |= std::uint64_t(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return in;
+  }
+  return nullptr;
+}
+
+inline float getFloat(byte_t const *in) {
+  auto bits = getLE<std::uint32_t>(in);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline void getFloats(byte_t const *in, float *values, std::size_t count) {
+  if (hostIsLittleEndian()) {
+    std::memcpy(values, in, count * sizeof(float));
+  } else {
+    for (std::size_t i = 0; i < count; ++i) {
+      values[i] = getFloat(in + i * sizeof(float));
+    }
+  }
+}
+
+} // namespace utils
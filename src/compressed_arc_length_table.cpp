@@ -0,0 +1,95 @@
+#include "compressed_arc_length_table.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace modelling {
+
+//
+// public interface
+//
+
+CompressedArcLengthTable::CompressedArcLengthTable(ArcLengthTable const &table)
+    : m_delta_s(table.deltaS()) {
+  std::vector<float> values(std::begin(table), std::end(table));
+  constexpr float kMaxOffset = std::numeric_limits<std::uint16_t>::max();
+
+  m_blocks.reserve((values.size() + kBlockSize - 1) / kBlockSize);
+  m_offsets.reserve(values.size());
+  for (size_t first = 0; first < values.size(); first += kBlockSize) {
+    auto last = std::min(first + kBlockSize, values.size());
+    auto range = std::minmax_element(std::begin(values) + first,
+                                     std::begin(values) + last);
+
+    // keyframe at the block minimum so that every offset is positive
+    Block block{*range.first, (*range.second - *range.first) / kMaxOffset};
+    m_blocks.push_back(block);
+
+    for (size_t i = first; i < last; ++i) {
+      float offset = 0.f;
+      if (block.scale > 0.f) {
+        offset = std::round((values[i] - block.base) / block.scale);
+      }
+      m_offsets.push_back(
+          std::uint16_t(std::min(std::max(offset, 0.f), kMaxOffset)));
+      m_maxError = std::max(m_maxError, std::abs(valueAt(i) - values[i]));
+    }
+  }
+}
+
+float CompressedArcLengthTable::nearestValueTo(float s) const {
+  auto index = indexAt(s);
+  if (index >= size()) {
+    return valueAt(size() - 1);
+  }
+  return valueAt(index);
+}
+
+float CompressedArcLengthTable::nextValueTo(float s) const {
+  auto index = indexAt(s);
+  if (index + 1 >= size()) {
+    return valueAt(0);
+  }
+  return valueAt(index + 1);
+}
+
+float CompressedArcLengthTable::operator()(float s) const {
+  return nearestValueTo(s);
+}
+
+float CompressedArcLengthTable::valueAt(size_t index) const {
+  auto const &block = m_blocks[index / kBlockSize];
+  return block.base + float(m_offsets[index]) * block.scale;
+}
+
+size_t CompressedArcLengthTable::size() const { return m_offsets.size(); }
+
+float CompressedArcLengthTable::deltaS() const { return m_delta_s; }
+
+float CompressedArcLengthTable::length() const { return size() * deltaS(); }
+
+size_t CompressedArcLengthTable::memoryBytes() const {
+  return m_blocks.size() * sizeof(Block) +
+         m_offsets.size() * sizeof(std::uint16_t);
+}
+
+float CompressedArcLengthTable::maxError() const { return m_maxError; }
+
+ArcLengthTable CompressedArcLengthTable::decompress() const {
+  ArcLengthTable::table_t values(size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = valueAt(i);
+  }
+  return ArcLengthTable(m_delta_s, std::move(values));
+}
+
+//
+// private functions
+//
+
+size_t CompressedArcLengthTable::indexAt(float s) const {
+  return static_cast<size_t>(std::floor(s / m_delta_s));
+}
+
+} // namespace modelling
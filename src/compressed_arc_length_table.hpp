@@ -0,0 +1,69 @@
+/**
+  Read-only, quantized copy of an ArcLengthTable.
+
+  The table is split into blocks of kBlockSize entries. Each block keeps its
+  first value as a float keyframe together with a scale, and every entry in
+  the block is stored as a 16-bit offset from the keyframe:
+
+          u_i = base[i / kBlockSize] + offset[i] * scale[i / kBlockSize]
+
+  Since table values increase monotonically, a block only spans a small
+  range of u and the 16-bit offsets lose very little precision. Entries take
+  a little over two bytes instead of four and any entry decodes in O(1) with
+  one multiply-add.
+
+  Lookups behave exactly like ArcLengthTable (including the wrap-around of
+  nextValueTo at the end of the table).
+  **/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "arc_length_parameterize.hpp"
+
+namespace modelling {
+
+class CompressedArcLengthTable {
+public: // types
+  static constexpr size_t kBlockSize = 64;
+
+public: // interface
+  CompressedArcLengthTable() = default;
+  explicit CompressedArcLengthTable(ArcLengthTable const &table);
+
+  // accessors
+  float nearestValueTo(float s) const;
+  float nextValueTo(float s) const;
+  float operator()(float s) const;
+  float valueAt(size_t index) const;
+
+  size_t size() const;
+  float deltaS() const;
+  float length() const;
+
+  // bytes held by the encoded values
+  size_t memoryBytes() const;
+  // largest difference to the source table, in u
+  float maxError() const;
+
+  ArcLengthTable decompress() const;
+
+private: // types
+  struct Block {
+    float base;
+    float scale;
+  };
+
+private: // functions
+  size_t indexAt(float s) const;
+
+private: // member variables
+  std::vector<Block> m_blocks;
+  std::vector<std::uint16_t> m_offsets;
+  float m_delta_s = 1.f;
+  float m_maxError = 0.f;
+};
+
+} // namespace modelling
@@ -1,10 +1,19 @@
 #include "curve_file_io.hpp"
 
+#include "binary_io.hpp"
+#include "mapped_file.hpp"
+#include "profiler.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <iterator>
-#include <sstream>
+#include <string_view>
+#include <utility>
 
 namespace modelling {
 
@@ -49,127 +58,426 @@ void saveHermiteCurveTo_OBJ_File(const HermiteCurve& curve,
     file.close();
 }
 
-std::optional<HermiteCurve>
-readHermiteCurveFromFile(std::string const &filePath) {
-  using std::istreambuf_iterator;
-  using std::string;
-  using std::stringstream;
-
-  HermiteCurve::control_points cps;
-  std::ifstream file(filePath);
+namespace {
 
-  if (!file) {
-    std::cerr << "Unable to open file " << filePath << '\n';
-    return std::nullopt;
-  }
+// whitespace as understood by the original istream based reader
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' ||
+         c == '\f';
+}
 
-  string line;
-  size_t index;
-  stringstream ss(std::ios_base::in);
+// calls lineFunc(line, lineNumber) for every line of the buffer, with comments
+// ('#' to the end of the line) and leading/trailing whitespace removed; empty
+// lines are skipped
+template <typename LineFunc>
+void forEachLine(std::string_view buffer, LineFunc lineFunc) {
   size_t lineNum = 0;
+  char const *ptr = buffer.data();
+  char const *end = ptr + buffer.size();
 
-  while (getline(file, line)) {
+  while (ptr < end) {
     ++lineNum;
+    auto *eol = static_cast<char const *>(std::memchr(ptr, '\n', end - ptr));
+    if (!eol)
+      eol = end;
 
     // remove comments
-    index = line.find_first_of("#");
-    if (index != string::npos) {
-      line.erase(index, string::npos);
-    }
+    auto *lineEnd =
+        static_cast<char const *>(std::memchr(ptr, '#', eol - ptr));
+    if (!lineEnd)
+      lineEnd = eol;
 
     // removes leading/tailing junk
-    line.erase(0, line.find_first_not_of(" \t\r\n\v\f"));
-    index = line.find_last_not_of(" \t\r\n\v\f") + 1;
-    if (index != string::npos) {
-      line.erase(index, string::npos);
+    auto *lineBegin = ptr;
+    while (lineBegin < lineEnd && isSpace(*lineBegin))
+      ++lineBegin;
+    while (lineEnd > lineBegin && isSpace(*(lineEnd - 1)))
+      --lineEnd;
+
+    if (lineBegin != lineEnd) {
+      lineFunc(std::string_view(lineBegin, lineEnd - lineBegin), lineNum);
     }
 
-    if (line.empty()) {
-      continue; // empty or commented out line
-    }
+    ptr = eol + 1;
+  }
+}
 
-    ss.str(line);
-    ss.clear();
+// parses count whitespace separated floats from the front of line
+bool parseFloats(std::string_view line, float *values, size_t count) {
+  char const *ptr = line.data();
+  char const *end = ptr + line.size();
+
+  for (size_t i = 0; i < count; ++i) {
+    while (ptr < end && isSpace(*ptr))
+      ++ptr;
+    if (ptr < end && *ptr == '+') // accepted by operator>>, not by from_chars
+      ++ptr;
+
+    auto [next, ec] = std::from_chars(ptr, end, values[i]);
+    if (ec != std::errc() || !std::isfinite(values[i])) // inf, nan
+      return false;
+    ptr = next;
+  }
+  return true;
+}
 
-    HermiteCurve::control_point_t cp;
-    ss >> cp;
+void reportParseError(std::string_view line, size_t lineNum) {
+  std::cerr << "Error read file: " << line << " (line: " << lineNum << ")\n";
+}
 
-    if (!ss) {
-      std::cerr << "Error read file: " + line +
-                       " (line: " + std::to_string(lineNum) + ")";
-    } else {
-      cps.push_back(cp);
-    }
-  }
-  file.close();
+// an upper bound on the number of control points in the file
+size_t countLines(std::string_view buffer) {
+  return std::count(std::begin(buffer), std::end(buffer), '\n') + 1;
+}
 
-  return HermiteCurve(cps);
+bool isOBJ(std::string const &filePath) {
+  auto dot = filePath.find_last_of('.');
+  return dot != std::string::npos && filePath.substr(dot) == ".obj";
 }
 
+// pointFunc(values) for every point of a control point file, read a line at
+// a time: position and tangent per line, or a position per OBJ vertex
+template <typename PointFunc>
+bool forEachFilePoint(std::string const &filePath, bool report,
+                      PointFunc pointFunc) {
+  std::ifstream file(filePath);
+  if (!file)
+    return false;
+
+  bool obj = isOBJ(filePath);
+  std::string text;
+  size_t lineNum = 0;
+  while (std::getline(file, text)) {
+    ++lineNum;
+    forEachLine(text, [&](std::string_view line, size_t) {
+      float values[6];
+      if (obj && line.front() != 'v')
+        return;
+      if (obj ? !parseFloats(line.substr(1), values, 3)
+              : !parseFloats(line, values, 6)) {
+        if (report)
+          reportParseError(line, lineNum);
+        return;
+      }
+      pointFunc(values);
+    });
+  }
+  return true;
+}
+
+} // namespace
+
 std::optional<HermiteCurve>
-readHermiteCurveFrom_OBJ_File(std::string const &filePath) {
-  using std::istreambuf_iterator;
-  using std::string;
-  using std::stringstream;
+readHermiteCurveFromFile(std::string const &filePath) {
+  utils::MappedFile file(filePath);
+
+  if (!file) {
+    std::cerr << "Unable to open file " << filePath << '\n';
+    return std::nullopt;
+  }
 
   HermiteCurve::control_points cps;
-  std::ifstream objFile(filePath);
+  cps.reserve(countLines(file.view()));
+
+  forEachLine(file.view(), [&](std::string_view line, size_t lineNum) {
+    float values[6];
+    if (!parseFloats(line, values, 6)) {
+      reportParseError(line, lineNum);
+      return;
+    }
+
+    HermiteCurve::control_point_t cp;
+    cp.position = {values[0], values[1], values[2]};
+    cp.tangent = {values[3], values[4], values[5]};
+    cps.push_back(cp);
+  });
+
+  return HermiteCurve(std::move(cps));
+}
+
+std::optional<HermiteCurve>
+readHermiteCurveFrom_OBJ_File(std::string const &filePath) {
+  PROFILE_ZONE("read OBJ track");
+  utils::MappedFile objFile(filePath);
 
   if (!objFile) {
     std::cerr << "Unable to open file " << filePath << '\n';
     return std::nullopt;
   }
 
-  string line;
-  size_t index;
-  stringstream ss(std::ios_base::in);
-  size_t lineNum = 0;
+  HermiteCurve::control_points cps;
+  cps.reserve(countLines(objFile.view()));
 
-  while (getline(objFile, line)) {
-    ++lineNum;
+  forEachLine(objFile.view(), [&](std::string_view line, size_t lineNum) {
+    if (line.front() != 'v') // only accept vertices (control points)
+      return;
 
-    // remove comments
-    index = line.find_first_of("#");
-    if (index != string::npos) {
-      line.erase(index, string::npos);
+    float values[3];
+    if (!parseFloats(line.substr(1), values, 3)) {
+      reportParseError(line, lineNum);
+      return;
     }
 
-    // removes leading/tailing junk
-    line.erase(0, line.find_first_not_of(" \t\r\n\v\f"));
-    index = line.find_last_not_of(" \t\r\n\v\f") + 1;
-    if (index != string::npos) {
-      line.erase(index, string::npos);
-    }
+    HermiteCurve::control_point_t cp;
+    cp.position = {values[0], values[1], values[2]};
+    cps.push_back(cp);
+  });
 
-    if (line.empty()) {
-      continue; // empty or commented out line
-    }
+  // set tangets
+  cps = modelling::calculateCatmullRomTangents(cps);
 
-    if (line.front() != 'v') // only accept vertices (control points)
-      continue;
+  return HermiteCurve(std::move(cps));
+}
 
-    ss.str(line);
-    ss.clear();
+std::optional<size_t> countControlPoints(std::string const &filePath) {
+  size_t count = 0;
+  if (!forEachFilePoint(filePath, false, [&](float const *) { ++count; }))
+    return std::nullopt;
+  return count;
+}
 
-    char isV; // stupid but meh
-    ss >> isV;
+std::optional<size_t> forEachControlPoint(
+    std::string const &filePath,
+    std::function<void(HermiteCurve::ControlPoint const &)> const &cpFunc) {
+  size_t count = 0;
+  if (!isOBJ(filePath)) {
+    bool read = forEachFilePoint(filePath, true, [&](float const *v) {
+      cpFunc({{v[0], v[1], v[2]}, {v[3], v[4], v[5]}});
+      ++count;
+    });
+    return read ? std::optional<size_t>(count) : std::nullopt;
+  }
 
-    HermiteCurve::control_point_t cp;
-    ss >> cp.position;
+  // Catmull-Rom tangents (see calculateCatmullRomTangents) from a window of
+  // three points, the first point's tangent needs the last one
+  vec3f last{0.f};
+  if (!forEachFilePoint(filePath, false,
+                        [&](float const *v) { last = {v[0], v[1], v[2]}; }))
+    return std::nullopt;
 
-    if (!ss) {
-      std::cerr << "Error read file: " + line +
-                       " (line: " + std::to_string(lineNum) + ")";
+  vec3f first{0.f}, previous = last, current{0.f};
+  forEachFilePoint(filePath, true, [&](float const *v) {
+    vec3f next{v[0], v[1], v[2]};
+    if (count == 0) {
+      first = current = next;
     } else {
-      cps.push_back(cp);
+      cpFunc({current, 0.5f * (next - previous)});
+      previous = current;
+      current = next;
     }
+    ++count;
+  });
+  if (count > 0)
+    cpFunc({current, 0.5f * (first - previous)});
+  return count;
+}
+
+//
+// binary track format (.trk)
+//
+//   header (64 bytes)
+//     char[8]  magic "RCTRACK"
+//     u32      version
+//     u32      flags                    bit 0: frames present
+//     u32      control point count      N
+//     u32      arc-length table size    T
+//     u32      frame count              F
+//     f32      arc length
+//     f32      arc-length table delta s
+//     f32      frame spacing
+//     u64      payload size in bytes
+//     u64      FNV-1a checksum of the header up to here, then the payload
+//              (version 1: of the payload only)
+//   payload, every section starts on a 16 byte boundary
+//     f32[N*6]   control points (position, tangent)
+//     f32[N+1]   cumulative arc lengths
+//     f32[T]     arc-length table (u values)
+//     f32[F*16]  frames (column major mat4)
+//
+// Everything is little-endian, so on little-endian hosts the sections of a
+// mapped file can be copied (or used) as-is.
+//
+namespace {
+
+using utils::byte_t;
+
+constexpr char kTrackMagic[8] = {'R', 'C', 'T', 'R', 'A', 'C', 'K', '\0'};
+constexpr std::uint32_t kTrackVersion = 2;
+constexpr std::uint32_t kTrackHasFrames = 1u << 0;
+constexpr size_t kTrackHeaderSize = 64;
+constexpr size_t kTrackChecksumOffset = 48;
+constexpr size_t kTrackSectionAlignment = 16;
+
+// where a section of count floats ends, starting after offset
+std::uint64_t sectionEnd(std::uint64_t offset, std::uint64_t count) {
+  offset = (offset + kTrackSectionAlignment - 1) / kTrackSectionAlignment *
+           kTrackSectionAlignment;
+  return offset + count * sizeof(float);
+}
+
+void putSection(std::vector<byte_t> &out, float const *values, size_t count) {
+  utils::padTo(out, kTrackSectionAlignment);
+  utils::putFloats(out, values, count);
+}
+
+// reads count floats from the next aligned section of the payload, returns
+// false if the payload is too short
+bool getSection(byte_t const *payload, size_t payloadSize, size_t &offset,
+                float *values, size_t count) {
+  offset = (offset + kTrackSectionAlignment - 1) / kTrackSectionAlignment *
+           kTrackSectionAlignment;
+  if (offset > payloadSize || count * sizeof(float) > payloadSize - offset)
+    return false;
+
+  utils::getFloats(payload + offset, values, count);
+  offset += count * sizeof(float);
+  return true;
+}
+
+} // namespace
+
+TrackData buildTrackData(HermiteCurve curve, float delta_u,
+                         size_t tableSegments) {
+  PROFILE_ZONE("buildTrackData");
+  TrackData track;
+  track.cumulativeArcLengths = cumulativeArcLengths(curve, delta_u);
+  track.arcLength = track.cumulativeArcLengths.back();
+  track.arcLengthTable = calculateArcLengthTable(
+      curve, track.arcLength / tableSegments, delta_u);
+  track.curve = std::move(curve);
+  return track;
+}
+
+void saveTrackBinary(TrackData const &track, std::string const &filePath) {
+  auto const &cps = track.curve.controlPoints();
+
+  std::vector<float> cpValues;
+  cpValues.reserve(cps.size() * 6);
+  for (auto const &cp : cps) {
+    cpValues.insert(std::end(cpValues),
+                    {cp.position.x, cp.position.y, cp.position.z, cp.tangent.x,
+                     cp.tangent.y, cp.tangent.z});
+  }
+  std::vector<float> table(std::begin(track.arcLengthTable),
+                           std::end(track.arcLengthTable));
+
+  std::vector<byte_t> payload;
+  putSection(payload, cpValues.data(), cpValues.size());
+  putSection(payload, track.cumulativeArcLengths.data(),
+            track.cumulativeArcLengths.size());
+  putSection(payload, table.data(), table.size());
+  if (!track.frames.empty()) {
+    putSection(payload, &track.frames.front()[0][0], track.frames.size() * 16);
   }
-  objFile.close();
 
-  // set tangets
-  cps = modelling::calculateCatmullRomTangents(cps);
+  std::vector<byte_t> header(std::begin(kTrackMagic), std::end(kTrackMagic));
+  utils::putLE(header, kTrackVersion);
+  utils::putLE(header, track.frames.empty() ? 0u : kTrackHasFrames);
+  utils::putLE(header, std::uint32_t(cps.size()));
+  utils::putLE(header, std::uint32_t(table.size()));
+  utils::putLE(header, std::uint32_t(track.frames.size()));
+  utils::putFloat(header, track.arcLength);
+  utils::putFloat(header, track.arcLengthTable.deltaS());
+  utils::putFloat(header, track.frameSpacing);
+  utils::putLE(header, std::uint64_t(payload.size()));
+  auto headerHash = utils::fnv1a(header.data(), kTrackChecksumOffset);
+  utils::putLE(header,
+               utils::fnv1a(payload.data(), payload.size(), headerHash));
+  header.resize(kTrackHeaderSize, 0);
+
+  std::ofstream file(filePath, std::ios::binary);
+  file.write(reinterpret_cast<char const *>(header.data()), header.size());
+  file.write(reinterpret_cast<char const *>(payload.data()), payload.size());
+  file.close();
+}
+
+std::optional<TrackData> loadTrackBinary(std::string const &filePath) {
+  PROFILE_ZONE("loadTrackBinary");
+  utils::MappedFile file(filePath);
+
+  if (!file) {
+    std::cerr << "Unable to open file " << filePath << '\n';
+    return std::nullopt;
+  }
+
+  auto error = [&](char const *what) {
+    std::cerr << "Error read track " << filePath << ": " << what << '\n';
+    return std::nullopt;
+  };
+
+  auto const *header = reinterpret_cast<byte_t const *>(file.data());
+  if (file.size() < kTrackHeaderSize ||
+      std::memcmp(header, kTrackMagic, sizeof(kTrackMagic)) != 0)
+    return error("not a binary track file");
+
+  auto version = utils::getLE<std::uint32_t>(header + 8);
+  if (version != 1 && version != kTrackVersion)
+    return error("unsupported version");
+
+  auto flags = utils::getLE<std::uint32_t>(header + 12);
+  size_t cpCount = utils::getLE<std::uint32_t>(header + 16);
+  size_t tableCount = utils::getLE<std::uint32_t>(header + 20);
+  size_t frameCount = utils::getLE<std::uint32_t>(header + 24);
+  float arcLength = utils::getFloat(header + 28);
+  float deltaS = utils::getFloat(header + 32);
+  float frameSpacing = utils::getFloat(header + 36);
+  auto payloadSize = utils::getLE<std::uint64_t>(header + 40);
+  auto checksum = utils::getLE<std::uint64_t>(header + 48);
+
+  auto const *payload = header + kTrackHeaderSize;
+  if (payloadSize != file.size() - kTrackHeaderSize)
+    return error("truncated");
+  auto headerHash = version == 1
+                        ? utils::fnv1a(nullptr, 0)
+                        : utils::fnv1a(header, kTrackChecksumOffset);
+  if (utils::fnv1a(payload, payloadSize, headerHash) != checksum)
+    return error("checksum mismatch");
+
+  // the counts have to describe exactly this payload before anything is
+  // sized by them
+  if (cpCount == 0)
+    return error("no control points");
+  auto expectedSize = sectionEnd(0, std::uint64_t(cpCount) * 6);
+  expectedSize = sectionEnd(expectedSize, cpCount + 1);
+  expectedSize = sectionEnd(expectedSize, tableCount);
+  if ((flags & kTrackHasFrames) && frameCount > 0)
+    expectedSize = sectionEnd(expectedSize, std::uint64_t(frameCount) * 16);
+  if (expectedSize != payloadSize)
+    return error("counts don't match the payload");
+
+  TrackData track;
+  size_t offset = 0;
+
+  std::vector<float> cpValues(cpCount * 6);
+  track.cumulativeArcLengths.resize(cpCount + 1);
+  ArcLengthTable::table_t table(tableCount);
+  if (!getSection(payload, payloadSize, offset, cpValues.data(),
+                 cpValues.size()) ||
+      !getSection(payload, payloadSize, offset,
+                 track.cumulativeArcLengths.data(), cpCount + 1) ||
+      !getSection(payload, payloadSize, offset, table.data(), tableCount))
+    return error("truncated");
+
+  if (flags & kTrackHasFrames) {
+    track.frames.resize(frameCount);
+    if (frameCount > 0 && !getSection(payload, payloadSize, offset,
+                                     &track.frames.front()[0][0],
+                                     frameCount * 16))
+      return error("truncated");
+    track.frameSpacing = frameSpacing;
+  }
+
+  HermiteCurve::control_points cps(cpCount);
+  for (size_t i = 0; i < cpCount; ++i) {
+    auto const *v = &cpValues[i * 6];
+    cps[i].position = {v[0], v[1], v[2]};
+    cps[i].tangent = {v[3], v[4], v[5]};
+  }
 
-  return HermiteCurve(cps);
+  track.curve = HermiteCurve(std::move(cps));
+  track.arcLength = arcLength;
+  track.arcLengthTable = ArcLengthTable(deltaS, std::move(table));
+  return track;
 }
 
 } // namespace modelling
@@ -1,22 +1,60 @@
 #pragma once
 
+#include <functional>
 #include <optional>
 #include <string>
+#include <vector>
 
+#include <glm/glm.hpp>
+
+#include "arc_length_parameterize.hpp"
 #include "hermite_curve.hpp"
 
 namespace modelling {
 
+// Everything needed to animate a track, so that a launch from a binary track
+// file can skip the arc-length parameterization entirely.
+struct TrackData {
+  HermiteCurve curve;
+  float arcLength = 0.f;
+  // arc length at each control point (see cumulativeArcLengths)
+  std::vector<float> cumulativeArcLengths;
+  ArcLengthTable arcLengthTable;
+
+  // optional frames sampled every frameSpacing along the track
+  float frameSpacing = 0.f;
+  std::vector<glm::mat4> frames;
+};
+
+// parameterizes curve by arc length, with tableSegments entries in the table
+TrackData buildTrackData(HermiteCurve curve, float delta_u,
+                         size_t tableSegments);
+
 void saveHermiteCurveToFile(modelling::HermiteCurve const &curve,
                             std::string const &filePath);
 
 void saveHermiteCurveTo_OBJ_File(modelling::HermiteCurve const& curve,
     std::string const& filePath);
 
+// versioned, little-endian binary track (.trk), see curve_file_io.cpp
+void saveTrackBinary(TrackData const &track, std::string const &filePath);
+
 std::optional<HermiteCurve>
 readHermiteCurveFromFile(std::string const &filePath);
 
 std::optional<HermiteCurve>
 readHermiteCurveFrom_OBJ_File(std::string const &filePath);
 
+std::optional<TrackData> loadTrackBinary(std::string const &filePath);
+
+// Control points of a text or OBJ (.obj) control point file, as the readers
+// above see them, handed to cpFunc one at a time. The file is read a line at
+// a time, so neither it nor the curve has to fit in memory (OBJ files are
+// read twice, for the tangent of the first point). Returns the number of
+// control points, nullopt if the file can't be read.
+std::optional<size_t> countControlPoints(std::string const &filePath);
+std::optional<size_t> forEachControlPoint(
+    std::string const &filePath,
+    std::function<void(HermiteCurve::ControlPoint const &)> const &cpFunc);
+
 } // namespace modelling
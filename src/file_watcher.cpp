@@ -0,0 +1,223 @@
+#include "file_watcher.hpp"
+
+#include "binary_io.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+//
+// public interface
+//
+
+FileWatcher::FileWatcher(std::chrono::milliseconds debounce,
+                         std::chrono::milliseconds pollInterval)
+    : m_debounce(debounce), m_pollInterval(pollInterval) {
+#ifdef __linux__
+  m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotifyFd < 0) {
+    std::cerr << "inotify unavailable, falling back to polling\n";
+  }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+  if (m_inotifyFd >= 0) {
+    close(m_inotifyFd);
+  }
+#endif
+}
+
+void FileWatcher::watch(std::string const &filePath, callback_t onChange) {
+  unwatch(filePath);
+
+  Entry entry;
+  entry.path = filePath;
+  fs::path p(filePath);
+  entry.fileName = p.filename().string();
+  entry.directory = p.has_parent_path() ? p.parent_path().string() : ".";
+  entry.onChange = std::move(onChange);
+
+  std::error_code ec;
+  entry.lastWrite = fs::last_write_time(p, ec);
+  entry.lastSize = fs::file_size(p, ec);
+  entry.contentHash = hashFileContents(filePath);
+
+  addDirectoryWatch(entry);
+  m_entries.push_back(std::move(entry));
+}
+
+void FileWatcher::unwatch(std::string const &filePath) {
+  auto iter = find(filePath);
+  if (iter == m_entries.end())
+    return;
+
+  Entry removed = std::move(*iter);
+  m_entries.erase(iter);
+  removeDirectoryWatch(removed);
+}
+
+void FileWatcher::poll() {
+  if (usingInotify()) {
+    readInotifyEvents();
+  } else {
+    pollTimestamps();
+  }
+
+  auto now = clock::now();
+  // callbacks may call watch/unwatch, so collect the settled paths first
+  std::vector<std::string> settled;
+  for (auto &entry : m_entries) {
+    if (entry.pending && now - entry.lastEvent >= m_debounce) {
+      entry.pending = false;
+      auto hash = hashFileContents(entry.path);
+      if (hash != 0 && hash != entry.contentHash) {
+        entry.contentHash = hash;
+        settled.push_back(entry.path);
+      }
+    }
+  }
+
+  for (auto const &path : settled) {
+    auto iter = find(path);
+    if (iter != m_entries.end()) {
+      auto onChange = iter->onChange;
+      onChange(path);
+    }
+  }
+}
+
+bool FileWatcher::usingInotify() const { return m_inotifyFd >= 0; }
+
+//
+// private functions
+//
+
+void FileWatcher::readInotifyEvents() {
+#ifdef __linux__
+  alignas(inotify_event) std::array<char, 4096> buffer;
+
+  while (true) {
+    auto length = read(m_inotifyFd, buffer.data(), buffer.size());
+    if (length <= 0)
+      break; // EAGAIN: nothing left to read
+
+    for (char *ptr = buffer.data(); ptr < buffer.data() + length;) {
+      auto const *event = reinterpret_cast<inotify_event const *>(ptr);
+      ptr += sizeof(inotify_event) + event->len;
+
+      if (event->len == 0)
+        continue;
+
+      for (auto &entry : m_entries) {
+        if (entry.watchDescriptor == event->wd &&
+            entry.fileName == event->name) {
+          markPending(entry);
+        }
+      }
+    }
+  }
+#endif
+}
+
+void FileWatcher::pollTimestamps() {
+  auto now = clock::now();
+  if (now - m_lastPoll < m_pollInterval)
+    return;
+  m_lastPoll = now;
+
+  for (auto &entry : m_entries) {
+    std::error_code ec;
+    auto lastWrite = fs::last_write_time(entry.path, ec);
+    if (ec)
+      continue; // file is mid-replace, try again next time
+    auto size = fs::file_size(entry.path, ec);
+
+    if (lastWrite != entry.lastWrite || size != entry.lastSize) {
+      entry.lastWrite = lastWrite;
+      entry.lastSize = size;
+      markPending(entry);
+    }
+  }
+}
+
+void FileWatcher::markPending(Entry &entry) {
+  entry.pending = true;
+  entry.lastEvent = clock::now();
+}
+
+void FileWatcher::addDirectoryWatch(Entry &entry) {
+#ifdef __linux__
+  if (!usingInotify())
+    return;
+
+  // watch the directory rather than the file, so that atomic saves
+  // (write temp file + rename over the original) are reported too
+  entry.watchDescriptor =
+      inotify_add_watch(m_inotifyFd, entry.directory.c_str(),
+                        IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE);
+  if (entry.watchDescriptor < 0) {
+    std::cerr << "Unable to watch " << entry.directory << '\n';
+  }
+#else
+  (void)entry;
+#endif
+}
+
+void FileWatcher::removeDirectoryWatch(Entry const &entry) {
+#ifdef __linux__
+  if (!usingInotify() || entry.watchDescriptor < 0)
+    return;
+
+  // inotify hands out one descriptor per directory, keep it while in use
+  bool shared = std::any_of(
+      std::begin(m_entries), std::end(m_entries), [&](Entry const &other) {
+        return other.watchDescriptor == entry.watchDescriptor;
+      });
+  if (!shared) {
+    inotify_rm_watch(m_inotifyFd, entry.watchDescriptor);
+  }
+#else
+  (void)entry;
+#endif
+}
+
+std::vector<FileWatcher::Entry>::iterator
+FileWatcher::find(std::string const &filePath) {
+  return std::find_if(
+      std::begin(m_entries), std::end(m_entries),
+      [&](Entry const &entry) { return entry.path == filePath; });
+}
+
+//
+// free function interface
+//
+
+std::uint64_t hashFileContents(std::string const &filePath) {
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file)
+    return 0;
+
+  std::uint64_t hash = fnv1a(nullptr, 0);
+  std::array<char, 1 << 16> buffer;
+  while (file) {
+    file.read(buffer.data(), buffer.size());
+    hash = fnv1a(reinterpret_cast<byte_t const *>(buffer.data()),
+                 size_t(file.gcount()), hash);
+  }
+  return hash;
+}
+
+} // namespace utils
@@ -0,0 +1,85 @@
+/**
+  Watches a set of files on disk and reports when their contents change.
+
+  On Linux the parent directory of every watched file is registered with
+  inotify, so editors that save through a temporary file and a rename are
+  still noticed. Everywhere else (or if inotify is unavailable) the files are
+  polled for a new modification time or size.
+
+  Bursts of writes are debounced: a callback fires once the file has been
+  quiet for the debounce interval, and only if the content hash differs from
+  the last one reported (touching a file does not trigger a reload).
+  **/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+class FileWatcher {
+public: // types
+  using clock = std::chrono::steady_clock;
+  using callback_t = std::function<void(std::string const &)>;
+
+public: // interface
+  explicit FileWatcher(
+      std::chrono::milliseconds debounce = std::chrono::milliseconds(250),
+      std::chrono::milliseconds pollInterval = std::chrono::milliseconds(500));
+  ~FileWatcher();
+
+  FileWatcher(FileWatcher const &) = delete;
+  FileWatcher &operator=(FileWatcher const &) = delete;
+
+  // register onChange for filePath (replaces a previous registration)
+  void watch(std::string const &filePath, callback_t onChange);
+  void unwatch(std::string const &filePath);
+
+  // drain pending events and fire callbacks for settled files, call once a
+  // frame from the thread that owns the data being reloaded
+  void poll();
+
+  bool usingInotify() const;
+
+private: // types
+  struct Entry {
+    std::string path;
+    std::string fileName;
+    std::string directory;
+    callback_t onChange;
+
+    std::filesystem::file_time_type lastWrite;
+    std::uintmax_t lastSize = 0;
+    std::uint64_t contentHash = 0;
+
+    int watchDescriptor = -1;
+    bool pending = false;
+    clock::time_point lastEvent;
+  };
+
+private: // functions
+  void readInotifyEvents();
+  void pollTimestamps();
+  void markPending(Entry &entry);
+  void addDirectoryWatch(Entry &entry);
+  void removeDirectoryWatch(Entry const &entry);
+
+  std::vector<Entry>::iterator find(std::string const &filePath);
+
+private: // member variables
+  std::vector<Entry> m_entries;
+  std::chrono::milliseconds m_debounce;
+  std::chrono::milliseconds m_pollInterval;
+  clock::time_point m_lastPoll;
+  int m_inotifyFd = -1;
+};
+
+// free function interface
+std::uint64_t hashFileContents(std::string const &filePath);
+
+} // namespace utils
@@ -1,27 +1,130 @@
 #include "hermite_curve.hpp"
 
+#include "profiler.h"
+
 #include <algorithm> // std::transform
 #include <iterator>
+#include <utility>
 
 namespace modelling {
 
+namespace {
+
+// segment and local parameter of u, false where the curve is clamped to its
+// first point (see evaluateCubicHermite)
+bool locateSegment(float u, size_t segmentCount, size_t &index, float &t) {
+  if (u <= 0.f || u >= 1.f) {
+    index = 0, t = 0.f;
+    return false;
+  }
+  float segment = segmentFrom(u, segmentCount);
+  index = std::min(size_t(segment), segmentCount - 1);
+  t = segment - float(index);
+  return true;
+}
+
+vec3f horner(HermiteCurve::Coefficients const &k, size_t i, float t) {
+  vec3f p;
+  for (int axis = 0; axis < 3; ++axis) {
+    p[axis] =
+        ((k.a[axis][i] * t + k.b[axis][i]) * t + k.c[axis][i]) * t +
+        k.d[axis][i];
+  }
+  return p;
+}
+
+vec3f hornerDerivative(HermiteCurve::Coefficients const &k, size_t i,
+                       float t) {
+  vec3f p;
+  for (int axis = 0; axis < 3; ++axis) {
+    p[axis] = (3.f * k.a[axis][i] * t + 2.f * k.b[axis][i]) * t +
+              k.c[axis][i];
+  }
+  return p;
+}
+
+} // namespace
+
 //
 // public interface
 //
 
+size_t HermiteCurve::Coefficients::size() const { return d[0].size(); }
+
 HermiteCurve::HermiteCurve(HermiteCurve::control_points controlPoints)
-    : m_cps(controlPoints) {}
+    : m_cps(std::move(controlPoints)) {
+  rebuildCoefficients();
+}
 
 // evaluate curve at u
 vec3f HermiteCurve::operator()(float u) const {
-  return evaluateCubicHermite(m_cps, u);
+  auto const &k = coefficients();
+  if (k.size() == 0)
+    return vec3f{0.f};
+  size_t index;
+  float t;
+  if (!locateSegment(u, k.size(), index, t))
+    return m_cps.front().position;
+  return horner(k, index, t);
+}
+
+vec3f HermiteCurve::firstDerivative(float u) const {
+  auto const &k = coefficients();
+  if (k.size() == 0)
+    return vec3f{0.f};
+  size_t index;
+  float t;
+  locateSegment(u, k.size(), index, t);
+  return float(k.size()) * hornerDerivative(k, index, t);
 }
 
 HermiteCurve::control_points const &HermiteCurve::controlPoints() const {
   return m_cps;
 }
 
-HermiteCurve::control_points &HermiteCurve::controlPoints() { return m_cps; }
+HermiteCurve::control_points &HermiteCurve::controlPoints() {
+  m_stale = true;
+  return m_cps;
+}
+
+HermiteCurve::Coefficients const &HermiteCurve::coefficients() const {
+  if (m_stale) {
+    rebuildCoefficients();
+  }
+  return m_coefficients;
+}
+
+//
+// private functions
+//
+
+void HermiteCurve::rebuildCoefficients() const {
+  auto n = m_cps.size();
+  for (auto *coefficient :
+       {&m_coefficients.a, &m_coefficients.b, &m_coefficients.c,
+        &m_coefficients.d}) {
+    for (auto &axis : *coefficient) {
+      axis.resize(n);
+    }
+  }
+
+  // the Hermite basis regrouped by powers of t
+  for (size_t i = 0; i < n; ++i) {
+    auto const &pA = m_cps[i].position;
+    auto const &tA = m_cps[i].tangent;
+    auto const &pB = nextValueOrWrap(i, m_cps).position;
+    auto const &tB = nextValueOrWrap(i, m_cps).tangent;
+    vec3f a = 2.f * pA + tA - 2.f * pB + tB;
+    vec3f b = -3.f * pA - 2.f * tA + 3.f * pB - tB;
+    for (int axis = 0; axis < 3; ++axis) {
+      m_coefficients.a[axis][i] = a[axis];
+      m_coefficients.b[axis][i] = b[axis];
+      m_coefficients.c[axis][i] = tA[axis];
+      m_coefficients.d[axis][i] = pA[axis];
+    }
+  }
+  m_stale = false;
+}
 
 //
 // free functions interface
@@ -76,6 +179,36 @@ vec3f evaluateCubicHermite(HermiteCurve::control_points const &cps, float u) {
   return evaluateCubicHermite(cpA, cpB, u);
 }
 
+void evaluateCubicHermiteBatch(HermiteCurve const &curve, float const *us,
+                               size_t count, vec3f *positions,
+                               vec3f *firstDerivatives,
+                               vec3f *secondDerivatives) {
+  auto const &k = curve.coefficients();
+  auto segmentCount = k.size();
+  if (segmentCount == 0)
+    return;
+
+  float scale = float(segmentCount); // d(local u) / du
+  auto const &first = curve.controlPoints().front().position;
+  for (size_t i = 0; i < count; ++i) {
+    size_t index;
+    float t;
+    bool inside = locateSegment(us[i], segmentCount, index, t);
+
+    positions[i] = inside ? horner(k, index, t) : first;
+    if (firstDerivatives) {
+      firstDerivatives[i] = scale * hornerDerivative(k, index, t);
+    }
+    if (secondDerivatives) {
+      vec3f d2;
+      for (int axis = 0; axis < 3; ++axis) {
+        d2[axis] = 6.f * k.a[axis][index] * t + 2.f * k.b[axis][index];
+      }
+      secondDerivatives[i] = (scale * scale) * d2;
+    }
+  }
+}
+
 std::vector<vec3f> sample(HermiteCurve const &curve, int sampleCount) {
   std::vector<vec3f> samples;
   samples.reserve(sampleCount);
@@ -91,6 +224,7 @@ std::vector<vec3f> sample(HermiteCurve const &curve, int sampleCount) {
 }
 
 float arcLength(HermiteCurve const &curve, float delta_u) {
+  PROFILE_ZONE("arcLength");
   assert(delta_u > 0.f);
   float l = 0.f;
   for (float u = 0.f; u < 1.f; u += delta_u) {
@@ -99,6 +233,26 @@ float arcLength(HermiteCurve const &curve, float delta_u) {
   return l;
 }
 
+std::vector<float> cumulativeArcLengths(HermiteCurve const &curve,
+                                        float delta_u) {
+  PROFILE_ZONE("cumulativeArcLengths");
+  assert(delta_u > 0.f);
+  auto segmentCount = curve.controlPoints().size();
+  std::vector<float> lengths;
+  lengths.reserve(segmentCount + 1);
+  lengths.push_back(0.f);
+
+  float l = 0.f;
+  for (size_t segment = 0; segment < segmentCount; ++segment) {
+    float uEnd = float(segment + 1) / segmentCount;
+    for (float u = float(segment) / segmentCount; u < uEnd; u += delta_u) {
+      l += length(curve(std::min(u + delta_u, uEnd)) - curve(u));
+    }
+    lengths.push_back(l);
+  }
+  return lengths;
+}
+
 HermiteCurve::control_points buildControlPoints(std::vector<vec3f> points) {
   HermiteCurve::control_points cps;
   cps.reserve(points.size());
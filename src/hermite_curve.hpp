@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 
+#include <array>
 #include <vector>
 
 namespace modelling {
@@ -21,18 +22,35 @@ public: // types
   using control_points = ControlPoints<ControlPoint>;
   using control_point_t = control_points::value_type;
 
+  // every segment in the power basis, p(t) = ((a t + b) t + c) t + d for t
+  // in [0, 1], one array per coefficient and axis
+  struct Coefficients {
+    std::array<std::vector<float>, 3> a, b, c, d;
+
+    size_t size() const;
+  };
+
 public: // interface
   HermiteCurve() = default;
   explicit HermiteCurve(control_points controlPoints);
 
   vec3f operator()(float u) const;
+  vec3f firstDerivative(float u) const; // with respect to u
 
   control_points const &controlPoints() const;
+  // marks the coefficients stale, they are rebuilt by the next evaluation
+  // (so share a curve between threads only once it has been evaluated)
   control_points &controlPoints();
 
+  Coefficients const &coefficients() const;
+
 private: // functions
+  void rebuildCoefficients() const;
+
 private: // member variables
   control_points m_cps;
+  mutable Coefficients m_coefficients;
+  mutable bool m_stale = true;
 };
 
 // free function interface
@@ -47,8 +65,21 @@ vec3f evaluateCubicHermite(HermiteCurve::ControlPoint const &cpA,
 
 vec3f evaluateCubicHermite(HermiteCurve::control_points const &cps, float u);
 
+// evaluates count parameters at once from the curve's coefficients,
+// positions match evaluateCubicHermite; first and second derivatives (with
+// respect to u) are optional
+void evaluateCubicHermiteBatch(HermiteCurve const &curve, float const *us,
+                               size_t count, vec3f *positions,
+                               vec3f *firstDerivatives = nullptr,
+                               vec3f *secondDerivatives = nullptr);
+
 float arcLength(HermiteCurve const &curve, float delta_u);
 
+// arc length from the start of the curve to each control point, the last
+// entry (one past the last control point) is the length of the closed curve
+std::vector<float> cumulativeArcLengths(HermiteCurve const &curve,
+                                        float delta_u);
+
 std::vector<vec3f> sample(HermiteCurve const &curve, int sampleCount);
 
 HermiteCurve::control_points buildControlPoints(std::vector<vec3f> points);
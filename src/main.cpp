@@ -1,5 +1,7 @@
+#include "frame_capture.h"
 #include "givio.h"
 #include "givr.h"
+#include "headless.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 //#include <glm/gtx/string_cast.hpp>
@@ -9,11 +11,19 @@
 
 #include "panel.h"
 #include "picking_controls.h"
+#include "profiler.h"
 #include "turntable_controls.h"
 
 #include "arc_length_parameterize.hpp"
+#include "compressed_arc_length_table.hpp"
 #include "curve_file_io.hpp"
+#include "file_watcher.hpp"
 #include "hermite_curve.hpp"
+#include "mapped_file.hpp"
+#include "ride_physics.hpp"
+#include "speed_table.hpp"
+#include "streaming_track.hpp"
+#include "trajectory_log.hpp"
 #include "utils.hpp"
 
 using namespace glm;
@@ -61,36 +71,119 @@ sampleTrack(modelling::HermiteCurve const &curve, size_t samplesCount) {
 	return geometry;
 }
 
-//
-// program entry point
-//
-int main(void) {
-	//
-	// initialize OpenGL and window
-	//
-	namespace givio = giv::io; // perhaps better than giv::io
-	givio::GLFWContext glContext;
-	glContext.glMajorVesion(4)
-			.glMinorVesion(0)
-			.glForwardComaptability(true)
-			.glCoreProfile()
-			.glAntiAliasingSamples(4)
-			.matchPrimaryMonitorVideoMode();
+// binary tracks (.trk) are loaded as-is, anything else is read as an OBJ
+// and parameterized by arc length
+bool isBinaryTrack(std::string const &path) {
+	auto dot = path.find_last_of('.');
+	return dot != std::string::npos && path.substr(dot) == ".trk";
+}
 
-	std::cout << givio::glfwVersionString() << '\n';
+std::string binaryTrackPath(std::string const &path) {
+	if (isBinaryTrack(path)) {
+		return path;
+	}
+	return path.substr(0, path.find_last_of('.')) + ".trk";
+}
 
-	//
-	// setup window (OpenGL context)
-	//
-	auto window =
-			glContext.makeImGuiWindow(givio::Properties()
-											  .size(givio::dimensions{1000, 1000})
-											  .title("Curve surfing...")
-											  .glslVersionString("#version 330 core"));
+std::optional<modelling::TrackData> readTrack(std::string const &path, float delta_u) {
+	if (isBinaryTrack(path)) {
+		return modelling::loadTrackBinary(path);
+	}
+	auto curve = modelling::readHermiteCurveFrom_OBJ_File(path);
+	if (!curve) {
+		return std::nullopt;
+	}
+	return modelling::buildTrackData(std::move(curve.value()), delta_u, 200);
+}
+
+// cart pose at s on a streamed track, built as calculateMatrixOfPoint does
+// from points on either side of it (which must be paged in)
+glm::mat4 streamingMatrixOfPoint(modelling::StreamingTrack &track, float speed, float s) {
+	auto at = [&](float value) {
+		value = std::fmod(value, track.length());
+		return track.pointAt(value < 0.f ? value + track.length() : value);
+	};
+	float delta_s = track.deltaS();
+	auto point = at(s);
+	auto tangent = glm::normalize(at(s + delta_s) - point);
+	auto normal = speed * speed * (at(s + delta_s * 20) - point * 2.f + at(s - delta_s * 20)) / (delta_s * delta_s) -
+			vec3{0.f, -10.f, 0.f};
+	auto biNormal = glm::normalize(glm::cross(tangent, normal));
+	tangent = glm::normalize(glm::cross(normal, biNormal));
+	normal = glm::cross(biNormal, tangent);
+	return glm::mat4(glm::vec4{biNormal, 0}, glm::vec4{normal, 0}, glm::vec4{tangent, 0}, glm::vec4{point + normal, 1.f});
+}
+
+// the stretch of a streamed track around s
+PolyLine<PrimitiveType::LINE_STRIP>
+sampleStreamingTrack(modelling::StreamingTrack &track, float s, float radius, float spacing) {
+	PolyLine<PrimitiveType::LINE_STRIP> geometry;
+	for (float offset = -radius; offset <= radius; offset += spacing) {
+		float value = std::fmod(s + offset, track.length());
+		geometry.push_back(Point(track.pointAt(value < 0.f ? value + track.length() : value)));
+	}
+	return geometry;
+}
+
+// Chrome trace of whatever the profiler still holds (open in
+// ui.perfetto.dev or chrome://tracing)
+void writeTrace(std::string const &path) {
+	if (profiler::writeChromeTrace(path)) {
+		std::cout << "Wrote trace " << path << '\n';
+	} else {
+		std::cerr << "Unable to write trace " << path << '\n';
+	}
+}
+
+namespace givio = giv::io; // perhaps better than giv::io
+
+// command line options that reach into the scene
+struct SceneOptions {
+	std::string captureOutput; // see FrameCapture
+	std::string recordPath;    // trajectory log of every simulation step
+	std::string replayPath;    // trajectory log that drives the train instead of the physics
+	std::string streamPath;    // streaming track (.trks), see runStreamingScene
+	bool packedTable = false;  // sample through a CompressedArcLengthTable
+};
+
+//
+// scene, shared by the window and the headless renderer
+//
+template <typename Window_t> void runScene(Window_t &window, SceneOptions const &options) {
+	// RC_TRACE=<file.json> writes a trace after RC_TRACE_FRAMES frames
+	// (default 300) or on exit, whichever comes first
+	char const *tracePath = std::getenv("RC_TRACE");
+	char const *traceFramesEnv = std::getenv("RC_TRACE_FRAMES");
+	int traceFrames = traceFramesEnv ? std::atoi(traceFramesEnv) : 300;
 
 	auto view = View(TurnTable(), Perspective());
-	// Preset Bindings
-	TurnTableControls controls(window, view.camera);
+	// Preset Bindings (mouse and keyboard need a real window)
+	std::unique_ptr<TurnTableControls<decltype(view.camera)>> controls;
+	if constexpr (std::is_base_of_v<givio::Window, Window_t>) {
+		controls = std::make_unique<TurnTableControls<decltype(view.camera)>>(window, view.camera);
+	}
+
+	// frames are read back from the offscreen framebuffer when headless
+	GLuint captureSource = 0;
+	if constexpr (std::is_same_v<Window_t, givio::HeadlessWindow>) {
+		captureSource = window.framebuffer();
+	}
+	std::unique_ptr<givio::FrameCapture> capture;
+	auto stopCapture = [&]() {
+		if (capture) {
+			capture->finish();
+			std::cout << "Captured " << capture->framesCaptured() << " frames to " << capture->output();
+			if (capture->framesDropped() > 0) {
+				std::cout << " (" << capture->framesDropped() << " dropped)";
+			}
+			std::cout << '\n';
+			capture.reset();
+		}
+	};
+	// headless runs record from the first frame when asked to
+	if (!options.captureOutput.empty() && !std::is_base_of_v<givio::Window, Window_t>) {
+		capture = std::make_unique<givio::FrameCapture>(options.captureOutput);
+	}
 
 	//
 	// setup simulation
@@ -104,12 +197,31 @@ int main(void) {
 		if (event.action == GLFW_PRESS) {
 			panel::showPanel = !panel::showPanel;
 		}
+	}) |
+	givio::Key(GLFW_KEY_T, [&](auto event) {
+		if (event.action == GLFW_PRESS) {
+			writeTrace("trace.json");
+		}
+	}) |
+	givio::Key(GLFW_KEY_R, [&](auto event) {
+		if (event.action != GLFW_PRESS)
+			return;
+		if (capture) {
+			stopCapture();
+		} else {
+			capture = std::make_unique<givio::FrameCapture>(
+					options.captureOutput.empty() ? "capture_%05d.ppm" : options.captureOutput);
+			std::cout << "Recording to " << capture->output() << '\n';
+		}
 	});
 
 	// initial curve --
 //	auto curve = initialCurve();
 	//To load the arc length parameterized curve (only worth part marks):
-  	auto curve = modelling::readHermiteCurveFrom_OBJ_File("./models/roller_coaster_1.obj").value();
+	float s = 0.f, delta_t = 1.f / 50.f, delta_u = 0.00001f, speed = 0.0f;
+	std::string trackPath = "./models/roller_coaster_1.obj";
+	auto track = readTrack(trackPath, delta_u).value();
+	auto curve = track.curve;
 
 	// control points
 	auto cp_geometry = controlPointsGeometry(curve);
@@ -120,128 +232,526 @@ int main(void) {
 	// In the place for a cart
 	auto sue_geometry = Mesh(Filename("./models/cart.obj"));
 	auto sue_style = Phong(Colour(1.f, 1.f, 1.f), LightPosition(100.f, 100.f, 100.f));
-	auto sue_renders = createInstancedRenderable(sue_geometry, sue_style);
+	// posed on the GPU from the track frames, see buildRails; the meshes keep
+	// int16 positions and normals and half float uvs on the GPU
+	auto sue_renders = createTrackInstancedRenderable(sue_geometry, sue_style, VertexFormat::Compact);
 
-	auto rail_geometry = Mesh(Filename("./models/block.obj"));
-	auto rail_renders = createInstancedRenderable(rail_geometry, sue_style);
-
-	auto earth_geometry = Mesh(Filename("./models/earth.obj"));
-	auto earth_renders = createInstancedRenderable(earth_geometry, sue_style);
+	// static scenery shares one set of buffers and a single draw, a mesh is
+	// picked by its index in scenery_geometry
+	std::vector<Mesh> scenery_geometry{Mesh(Filename("./models/block.obj")), Mesh(Filename("./models/earth.obj"))};
+	size_t const rail_mesh = 0, earth_mesh = 1;
+	// rails are rigid frames at a uniform scale, 24 bytes each is plenty
+	auto scenery_renders = createMultiMeshRenderable(scenery_geometry, sue_style, InstanceLayout::TQSHalf, VertexFormat::Compact);
 
 
 	auto track_geometry = sampleTrack(curve, 500);
 	auto track_style = GL_Line(Width(15.), Colour(0.2, 0.7, 1.0));
 	auto track_render = createRenderable(track_geometry, track_style);
 
-	float s = 0.f, delta_t = 1.f / 50.f, delta_u = 0.00001f, speed = 0.0f;
-	float arc_length = modelling::arcLength(curve, delta_u);
-	float delta_s = arc_length / 200;
-	modelling::ArcLengthTable arcLengthTable = modelling::calculateArcLengthTable(curve, delta_s, delta_u);
-	auto maxPoint = utils::getMaxPoint(curve, arcLengthTable) + vec3{0.f, 5.f, 0.f};
+	// labels for the GPU timers in the profiler panel
+	cp_render.name = "control points";
+	sue_renders.name = "carts";
+	scenery_renders.name = "scenery";
+	track_render.name = "track";
+
+	// the draws of a frame, sorted by program and mesh before they are issued
+	givr::RenderQueue renderQueue;
+
+	float arc_length = track.arcLength;
+	float delta_s = track.arcLengthTable.deltaS();
+	modelling::ArcLengthTable arcLengthTable = track.arcLengthTable;
+	// --packed-table samples the track through the quantized table instead
+	// (see tools/arc_length_bench.cpp for its size and cost)
+	std::optional<modelling::CompressedArcLengthTable> packedTable;
+	if (options.packedTable) {
+		packedTable.emplace(arcLengthTable);
+	}
+	auto withTable = [&](auto sampler) {
+		return packedTable ? sampler(*packedTable) : sampler(arcLengthTable);
+	};
+	auto speedSettings = [] {
+		modelling::SpeedTableSettings settings;
+		settings.friction = panel::friction;
+		settings.drag = panel::drag;
+		return settings;
+	};
+	auto speedTable = modelling::calculateSpeedTable(curve, arcLengthTable, arc_length, speedSettings());
+
+	// ride dynamics, zones come from the track's .zones file or default to a
+	// lift up to the top and brakes over the last quarter
+	auto loadZones = [&](modelling::RidePhysics &physics, std::string const &path) {
+		auto zones = modelling::readTrackZones(modelling::zonesPathFor(path), physics.length());
+		if (!zones) {
+			zones = modelling::defaultRideZones(physics);
+		}
+		physics.setZones(modelling::TrackZones(std::move(*zones), physics.length()));
+	};
+	auto makePhysics = [&](std::string const &path) {
+		modelling::RidePhysicsSettings settings;
+		settings.friction = panel::friction;
+		settings.drag = panel::drag;
+		modelling::RidePhysics physics(curve, settings);
+		loadZones(physics, path);
+		return physics;
+	};
+	auto physics = makePhysics(trackPath);
+	modelling::RideState ride;
 //	std::cout<<arc_length<<" "<<arcLengthTable.size()<<std::endl;
+	std::vector<glm::mat4> frames;
+	float frameSpacing = 0.f;
 	std::vector<glm::mat4> rails;
 
+	// rails sit on frames about every half table step, stretched so that a
+	// whole number of them spans the track and the frame table wraps at
+	// exactly arc_length. Binary tracks may carry them precomputed.
+	auto buildRails = [&](std::vector<glm::mat4> precomputed, float spacing) {
+		PROFILE_ZONE("rail build");
+		auto count = std::max<size_t>(1, size_t(std::round(arc_length / (delta_s / 2))));
+		frameSpacing = arc_length / float(count);
+		frames = std::move(precomputed);
+		if (frames.size() != count || spacing != frameSpacing) {
+			frames.clear();
+			frames.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				float rail_s = float(i) * frameSpacing;
+				frames.push_back(withTable([&](auto const &table) {
+					auto rail_point = utils::getInterpolatedPoint(curve, table, delta_s, rail_s);
+					return utils::calculateMatrixOfPoint(curve, table, speedTable.speedAt(rail_s), rail_point, arc_length, delta_s, rail_s);
+				}));
+			}
+		}
+		rails.clear();
+		for (auto const &m : frames) {
+			rails.emplace_back(scale(m, vec3{1 / 3.f}));
+		}
+		setFrameTable(sue_renders, frames, frameSpacing);
+	};
+
+	// recorded trajectories, a replay takes the place of the physics
+	std::unique_ptr<modelling::TrajectoryRecorder> recorder;
+	if (!options.recordPath.empty()) {
+		recorder = std::make_unique<modelling::TrajectoryRecorder>(options.recordPath, delta_t, arc_length);
+	}
+	// a recording holds a single track length, so it ends with that track
+	auto finishRecording = [&]() {
+		if (recorder) {
+			recorder->finish();
+			std::cout << "Recorded " << recorder->sampleCount() << " steps to " << options.recordPath << '\n';
+			recorder.reset();
+		}
+	};
+	std::unique_ptr<modelling::TrajectoryReplay> replay;
+	size_t replayStep = 0;
+	if (!options.replayPath.empty()) {
+		replay = std::make_unique<modelling::TrajectoryReplay>(options.replayPath);
+		if (!replay->isOpen()) {
+			replay.reset();
+		}
+	}
+
+	// hot reload: the track and meshes are re-read whenever they change on disk,
+	// possibly while an editor is still rewriting them
+	utils::FileWatcher watcher;
+	utils::MappedFile::setFilesMayChange(true);
+
+	auto loadTrack = [&](std::string const &path) {
+		auto loaded = readTrack(path, delta_u);
+		if (!loaded) {
+			return false;
+		}
+		finishRecording();
+		curve = loaded->curve;
+
+		// reload cps to GPU
+		cp_geometry = controlPointsGeometry(curve);
+		updateRenderable(cp_geometry, cp_style, cp_render);
+
+		// reload curve to GPU
+		track_geometry = sampleTrack(curve, 500);
+		updateRenderable(track_geometry, track_style, track_render);
+
+		// reset
+		s = 0.f, delta_t = 1.f / 50.f, delta_u = 0.00001f, speed = 0.0f;
+		arc_length = loaded->arcLength;
+		delta_s = loaded->arcLengthTable.deltaS();
+		arcLengthTable = std::move(loaded->arcLengthTable);
+		if (packedTable) {
+			packedTable.emplace(arcLengthTable);
+		}
+		speedTable = modelling::calculateSpeedTable(curve, arcLengthTable, arc_length, speedSettings());
+		physics = makePhysics(path);
+		ride = {};
+
+		buildRails(std::move(loaded->frames), loaded->frameSpacing);
+		return true;
+	};
+
+	auto saveTrack = [&](std::string const &path) {
+		modelling::TrackData out;
+		out.curve = curve;
+		out.cumulativeArcLengths = modelling::cumulativeArcLengths(curve, delta_u);
+		out.arcLength = arc_length;
+		out.arcLengthTable = arcLengthTable;
+		out.frameSpacing = frameSpacing;
+		out.frames = frames;
+		modelling::saveTrackBinary(out, path);
+		std::cout << "Saved " << path << '\n';
+	};
+
+	auto watchTrack = [&](std::string const &path) {
+		watcher.unwatch(trackPath);
+		watcher.unwatch(modelling::zonesPathFor(trackPath));
+		trackPath = path;
+		watcher.watch(trackPath, [&](std::string const &changed) {
+			std::cout << "Reloading track " << changed << '\n';
+			loadTrack(changed);
+		});
+		// zones only touch the physics, the train keeps its place
+		watcher.watch(modelling::zonesPathFor(trackPath), [&](std::string const &changed) {
+			std::cout << "Reloading zones " << changed << '\n';
+			loadZones(physics, trackPath);
+			ride.cursor = {};
+			ride.dwell = 0.f;
+			ride.departing = false;
+		});
+	};
+
+	// meshes only need their own renderable refreshed, the track is untouched
+	watcher.watch(sue_geometry.filename(), [&](std::string const &) {
+		updateRenderable(sue_geometry, sue_style, sue_renders);
+	});
+	for (auto const &geometry : scenery_geometry) {
+		watcher.watch(geometry.filename(), [&](std::string const &) {
+			updateRenderable(scenery_geometry, sue_style, scenery_renders);
+		});
+	}
+	watchTrack(trackPath);
+
 	auto applyPanel = [&]() {
 		if (panel::rereadControlPoints) {
 			// load points
-			auto loaded = modelling::readHermiteCurveFrom_OBJ_File(
-					panel::controlPointsFilePath);
-			if (loaded) {
-				curve = loaded.value();
-
-				// reload cps to GPU
-				cp_geometry = controlPointsGeometry(curve);
-				updateRenderable(cp_geometry, cp_style, cp_render);
-
-				// reload curve to GPU
-				track_geometry = sampleTrack(curve, 500);
-				updateRenderable(track_geometry, track_style, track_render);
-
-				// reset
-				s = 0.f, delta_t = 1.f / 50.f, delta_u = 0.00001f, speed = 0.0f;
-				arc_length = modelling::arcLength(curve, delta_u);
-				delta_s = arc_length / 200;
-				arcLengthTable = modelling::calculateArcLengthTable(curve, delta_s, delta_u);
-				maxPoint = utils::getMaxPoint(curve, arcLengthTable) + vec3{0.f, 5.f, 0.f};
-
-				rails.clear();
-				for (float rail_s = 0; rail_s < arc_length; rail_s += delta_s/2) {
-					auto rail_point = utils::getInterpolatedPoint(curve, arcLengthTable, delta_s, rail_s);
-					auto m = utils::calculateMatrixOfPoint(curve, arcLengthTable, maxPoint, rail_point, arc_length, delta_s, rail_s);
-					rails.emplace_back(scale(m, vec3{1 / 3.f}));
-				}
+			if (loadTrack(panel::controlPointsFilePath)) {
+				watchTrack(panel::controlPointsFilePath);
 			}
+		}
 
+		if (panel::saveBinaryTrack) {
+			saveTrack(binaryTrackPath(trackPath));
 		}
 
 		if (panel::resetView) {
 			view.camera.reset();
 		}
-	};
-
 
-	for (float rail_s = 0; rail_s < arc_length; rail_s += delta_s / 2) {
-		auto rail_point = utils::getInterpolatedPoint(curve, arcLengthTable, delta_s, rail_s);
-		auto m = utils::calculateMatrixOfPoint(curve, arcLengthTable, maxPoint, rail_point, arc_length, delta_s, rail_s);
-		rails.emplace_back(scale(m, vec3{1/3.f}));
-	}
+		if (panel::speedSettingsChanged) {
+			// the zones are re-read by the watcher, not while a slider is dragged
+			physics.setResistance(panel::friction, panel::drag);
+		}
+		if (panel::speedSettingsSettled) {
+			// the rails bank for the table's speeds, both are rebuilt once the
+			// slider is let go rather than on every frame of the drag
+			speedTable = modelling::calculateSpeedTable(curve, arcLengthTable, arc_length, speedSettings());
+			buildRails({}, 0.f);
+		}
+	};
 
+	buildRails(std::move(track.frames), track.frameSpacing);
 
 	mainloop(std::move(window), [&](float) {
-		applyPanel();
-
-		for (auto const& rail_mat: rails) {
-			addInstance(rail_renders,  rail_mat);
+		if (tracePath && --traceFrames == 0) {
+			writeTrace(tracePath);
+			tracePath = nullptr;
 		}
 
-		addInstance(earth_renders, glm::translate(mat4{1.f}, vec3{0.f, -20.f, 0.f}));
+		{
+			PROFILE_ZONE("hot reload");
+			watcher.poll();
+		}
+		{
+			PROFILE_ZONE("applyPanel");
+			applyPanel();
+		}
 
-		auto lastPoint = utils::getInterpolatedPoint(curve, arcLengthTable, delta_s, s);
-		if (panel::play) {
-			s += speed * delta_t;
-			if (s >= arc_length) {
-				s -= arc_length;
+		{
+			PROFILE_ZONE("scenery poses");
+			for (auto const& rail_mat: rails) {
+				addInstance(scenery_renders, rail_mesh, rail_mat);
 			}
+
+			addInstance(scenery_renders, earth_mesh, glm::translate(mat4{1.f}, vec3{0.f, -20.f, 0.f}));
 		}
 
-		for (int i = 0; i < 3; i++) {
-			float point_s = s - i * delta_s;
-			auto point = utils::getInterpolatedPoint(curve, arcLengthTable, delta_s, point_s);
-			auto m = utils::calculateMatrixOfPoint(curve, arcLengthTable, maxPoint, point, arc_length, delta_s, point_s, true);
-			addInstance(sue_renders, m);
+		auto lastPoint = withTable([&](auto const &table) { return utils::getInterpolatedPoint(curve, table, delta_s, s); });
+		if (panel::play && replay) {
+			auto sample = replay->sample(replayStep++);
+			s = sample.s;
+			speed = sample.speed;
+		} else if (panel::play) {
+			PROFILE_ZONE("physics");
+			physics.step(ride, delta_t);
+			s = ride.s;
+			speed = ride.speed;
+			if (recorder) {
+				recorder->record({s, speed, ride.phase});
+			}
 		}
 
-		auto point = utils::getInterpolatedPoint(curve, arcLengthTable, delta_s, s);
-		if (panel::play) {
-			if (s >= arc_length * 0.75 && speed > 1e-4) {
-				float dist = arc_length - s;
-				speed -= (speed * speed) / (2 * dist) * delta_t;
-//			} else if (speed < utils::getEnoughSpeed(point, maxPoint, delta_t)) {
-//				speed += acceleration;
-			} else {
-				speed = utils::getEnoughSpeed(point, maxPoint);
+		{
+			PROFILE_ZONE("cart poses");
+			// lifted by the unit normal as calculateMatrixOfPoint's translateWagon
+			for (int i = 0; i < 3; i++) {
+				addInstance(sue_renders, s - i * delta_s, 1.f);
 			}
-//			std::cout<<speed<<std::endl;
 		}
+
+		auto point = withTable([&](auto const &table) { return utils::getInterpolatedPoint(curve, table, delta_s, s); });
 //		speed += utils::getDeltaSpeed(point, lastPoint, delta_t);
 
+		PROFILE_ZONE("draw");
 		auto color = panel::clear_color;
 		glClearColor(color.x, color.y, color.z, color.z);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		view.projection.updateAspectRatio(window.width(), window.height());
 		view.camera.translate(point);
-		draw(cp_render, view);
+		{
+			PROFILE_ZONE("draw queue");
+			renderQueue.submit(cp_render, view);
+			renderQueue.submit(sue_renders, view);
+			renderQueue.submit(track_render, view);
+			renderQueue.submit(scenery_renders, view);
+			renderQueue.execute();
+		}
+
+		view.camera.translate(-point);
+
+		// before the panel is drawn, so recordings show only the scene
+		if (capture) {
+			capture->capture(captureSource);
+		}
+	});
+
+	stopCapture();
+	finishRecording();
+	if (tracePath) {
+		writeTrace(tracePath);
+	}
+}
+
+//
+// streamed track, for tracks too long to expand in memory (see
+// tools/make_streaming_track.cpp). Only the chunks around the train and the
+// camera are resident. The ride physics need the whole curve, so the train
+// cruises at a fixed speed, and only the stretch of track around the camera
+// is drawn.
+//
+template <typename Window_t> void runStreamingScene(Window_t &window, SceneOptions const &options) {
+	modelling::StreamingTrack track(options.streamPath, 16);
+	if (!track.isOpen()) {
+		return;
+	}
+
+	auto view = View(TurnTable(), Perspective());
+	std::unique_ptr<TurnTableControls<decltype(view.camera)>> controls;
+	if constexpr (std::is_base_of_v<givio::Window, Window_t>) {
+		controls = std::make_unique<TurnTableControls<decltype(view.camera)>>(window, view.camera);
+	}
+
+	GLuint captureSource = 0;
+	if constexpr (std::is_same_v<Window_t, givio::HeadlessWindow>) {
+		captureSource = window.framebuffer();
+	}
+	std::unique_ptr<givio::FrameCapture> capture;
+	if (!options.captureOutput.empty()) {
+		capture = std::make_unique<givio::FrameCapture>(options.captureOutput);
+	}
+
+	// the camera follows the train until C parks it where it is
+	float s = 0.f, camera_s = 0.f, delta_t = 1.f / 50.f, speed = 10.f;
+	bool followTrain = true;
+	window.keyboardCommands() |
+	givio::Key(GLFW_KEY_V, [&](auto) { view.camera.reset(); }) |
+	givio::Key(GLFW_KEY_P, [&](auto event) {
+		if (event.action == GLFW_PRESS) {
+			panel::showPanel = !panel::showPanel;
+		}
+	}) |
+	givio::Key(GLFW_KEY_C, [&](auto event) {
+		if (event.action == GLFW_PRESS) {
+			followTrain = !followTrain;
+		}
+	});
+
+	auto cart_geometry = Mesh(Filename("./models/cart.obj"));
+	auto cart_style = Phong(Colour(1.f, 1.f, 1.f), LightPosition(100.f, 100.f, 100.f));
+	auto cart_renders = createInstancedRenderable(cart_geometry, cart_style);
+
+	// resampled once the camera has moved on by a metre
+	float const track_radius = std::min(150.f, track.length() / 2), track_spacing = 0.5f;
+	auto track_style = GL_Line(Width(15.), Colour(0.2, 0.7, 1.0));
+	track.prefetch(camera_s, track_radius);
+	auto track_geometry = sampleStreamingTrack(track, camera_s, track_radius, track_spacing);
+	auto track_render = createRenderable(track_geometry, track_style);
+	float sampled_s = camera_s;
+
+	cart_renders.name = "carts";
+	track_render.name = "track";
+	givr::RenderQueue renderQueue;
+
+	std::cout << "Streaming " << options.streamPath << ": " << track.length() << " m in " << track.chunkCount()
+			  << " chunks\n";
+
+	mainloop(std::move(window), [&](float) {
+		if (panel::play) {
+			s = std::fmod(s + speed * delta_t, track.length());
+		}
+		if (followTrain) {
+			camera_s = s;
+		}
+
+		{
+			PROFILE_ZONE("track paging");
+			// carts reach back three table steps, and their frames twenty more
+			track.prefetch(s, track.deltaS() * 24);
+			track.prefetch(camera_s, track_radius);
+		}
 
-		draw(sue_renders, view);
+		if (std::abs(camera_s - sampled_s) > 1.f) {
+			PROFILE_ZONE("track resample");
+			track_geometry = sampleStreamingTrack(track, camera_s, track_radius, track_spacing);
+			updateRenderable(track_geometry, track_style, track_render);
+			sampled_s = camera_s;
+		}
 
-		draw(track_render, view);
+		{
+			PROFILE_ZONE("cart poses");
+			for (int i = 0; i < 3; i++) {
+				addInstance(cart_renders, streamingMatrixOfPoint(track, speed, s - i * track.deltaS()));
+			}
+		}
 
-		draw(rail_renders, view);
-		draw(earth_renders, view);
+		auto point = track.pointAt(camera_s);
 
+		PROFILE_ZONE("draw");
+		auto color = panel::clear_color;
+		glClearColor(color.x, color.y, color.z, color.z);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		view.projection.updateAspectRatio(window.width(), window.height());
+		view.camera.translate(point);
+		renderQueue.submit(cart_renders, view);
+		renderQueue.submit(track_render, view);
+		renderQueue.execute();
 		view.camera.translate(-point);
 
+		if (capture) {
+			capture->capture(captureSource);
+		}
 	});
 
+	if (capture) {
+		capture->finish();
+		std::cout << "Captured " << capture->framesCaptured() << " frames to " << capture->output() << '\n';
+	}
+}
+
+//
+// program entry point
+//
+//   a1_base                       interactive window
+//   a1_base --headless [--size WxH] [--frames N]
+//                                 offscreen benchmark (EGL, no display needed)
+//   --capture <output>            records frames (R toggles it in the window),
+//                                 name.ppm with %d for an image sequence,
+//                                 anything else is encoded by ffmpeg
+//   --record <file.rctraj>        records the train's trajectory, until the
+//                                 track is reloaded
+//   --replay <file.rctraj>        replays a recorded trajectory
+//   --stream <file.trks>          rides a streaming track instead (C parks
+//                                 the camera), see make_streaming_track
+//   --packed-table                samples the track through the 16 bit
+//                                 quantized arc-length table
+//
+int main(int argc, char *argv[]) {
+	profiler::setThreadName("main");
+
+	bool headless = false;
+	givio::dimensions size{1000, 1000};
+	size_t frames = 600;
+	SceneOptions options;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--headless") {
+			headless = true;
+		} else if (arg == "--size" && i + 1 < argc) {
+			std::sscanf(argv[++i], "%ux%u", &size.width, &size.height);
+		} else if (arg == "--frames" && i + 1 < argc) {
+			frames = std::strtoul(argv[++i], nullptr, 10);
+		} else if (arg == "--capture" && i + 1 < argc) {
+			options.captureOutput = argv[++i];
+		} else if (arg == "--record" && i + 1 < argc) {
+			options.recordPath = argv[++i];
+		} else if (arg == "--replay" && i + 1 < argc) {
+			options.replayPath = argv[++i];
+		} else if (arg == "--stream" && i + 1 < argc) {
+			options.streamPath = argv[++i];
+		} else if (arg == "--packed-table") {
+			options.packedTable = true;
+		} else {
+			std::cerr << "Unknown argument " << arg << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (headless) {
+		givio::HeadlessContext glContext;
+		glContext.glMajorVesion(4).glMinorVesion(0);
+		auto window = glContext.makeWindow(givio::Properties().size(size), frames);
+		if (!window) {
+			return EXIT_FAILURE;
+		}
+		std::cout << "Headless: " << glContext.rendererString() << '\n';
+
+		// nobody is there to press play
+		panel::play = true;
+		if (options.streamPath.empty()) {
+			runScene(*window, options);
+		} else {
+			runStreamingScene(*window, options);
+		}
+		// the scene's GL objects are released, delete them while the
+		// context is still current
+		givr::glResources().flush();
+		window->printReport(std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	//
+	// initialize OpenGL and window
+	//
+	givio::GLFWContext glContext;
+	glContext.glMajorVesion(4)
+			.glMinorVesion(0)
+			.glForwardComaptability(true)
+			.glCoreProfile()
+			.glAntiAliasingSamples(4)
+			.matchPrimaryMonitorVideoMode();
+
+	std::cout << givio::glfwVersionString() << '\n';
+
+	//
+	// setup window (OpenGL context)
+	//
+	auto window =
+			glContext.makeImGuiWindow(givio::Properties()
+											  .size(size)
+											  .title("Curve surfing...")
+											  .glslVersionString("#version 330 core"));
+
+	if (options.streamPath.empty()) {
+		runScene(window, options);
+	} else {
+		runStreamingScene(window, options);
+	}
+	givr::glResources().flush();
+
 	return EXIT_SUCCESS;
 }
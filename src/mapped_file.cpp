@@ -0,0 +1,152 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_USE_MMAP 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+bool filesMayChange = false;
+
+} // namespace
+
+//
+// public interface
+//
+
+MappedFile::MappedFile(std::string const &filePath) {
+#ifdef MAPPED_FILE_USE_MMAP
+  int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+
+  struct stat info;
+  if (filesMayChange) {
+    readCopy(fd);
+  } else if (fstat(fd, &info) == 0) {
+    m_open = true;
+    m_size = static_cast<std::size_t>(info.st_size);
+    if (m_size > 0) {
+      void *ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr != MAP_FAILED) {
+        madvise(ptr, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<char const *>(ptr);
+        m_mapped = true;
+      } else {
+        m_open = false;
+        m_size = 0;
+      }
+    }
+    // changed between the stat and the map, don't touch the mapping
+    struct stat mappedInfo;
+    if (m_mapped && (fstat(fd, &mappedInfo) != 0 ||
+                     std::size_t(mappedInfo.st_size) != m_size)) {
+      release();
+      readCopy(fd);
+    }
+  }
+  close(fd);
+#else
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file)
+    return;
+
+  m_fallback.assign(std::istreambuf_iterator<char>(file),
+                    std::istreambuf_iterator<char>());
+  m_data = m_fallback.data();
+  m_size = m_fallback.size();
+  m_open = true;
+#endif
+}
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    release();
+    m_fallback = std::move(other.m_fallback);
+    m_data = other.m_mapped ? other.m_data : m_fallback.data();
+    m_size = other.m_size;
+    m_mapped = other.m_mapped;
+    m_open = other.m_open;
+
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_mapped = false;
+    other.m_open = false;
+  }
+  return *this;
+}
+
+void MappedFile::setFilesMayChange(bool mayChange) {
+  filesMayChange = mayChange;
+}
+
+bool MappedFile::isOpen() const { return m_open; }
+
+MappedFile::operator bool() const { return isOpen(); }
+
+char const *MappedFile::data() const { return m_data; }
+
+std::size_t MappedFile::size() const { return m_size; }
+
+std::string_view MappedFile::view() const { return {m_data, m_size}; }
+
+//
+// private functions
+//
+
+void MappedFile::release() {
+#ifdef MAPPED_FILE_USE_MMAP
+  if (m_mapped) {
+    munmap(const_cast<char *>(m_data), m_size);
+  }
+#endif
+  m_fallback.clear();
+  m_data = nullptr;
+  m_size = 0;
+  m_mapped = false;
+  m_open = false;
+}
+
+// whatever the file holds while it is read, a file truncated meanwhile just
+// reads short (and fails to parse) instead of faulting
+void MappedFile::readCopy(int fd) {
+#ifdef MAPPED_FILE_USE_MMAP
+  if (lseek(fd, 0, SEEK_SET) != 0)
+    return;
+  char chunk[1 << 16];
+  for (;;) {
+    auto got = read(fd, chunk, sizeof(chunk));
+    if (got < 0) {
+      if (errno == EINTR)
+        continue;
+      m_fallback.clear();
+      return;
+    }
+    if (got == 0)
+      break;
+    m_fallback.insert(std::end(m_fallback), chunk, chunk + got);
+  }
+  m_data = m_fallback.data();
+  m_size = m_fallback.size();
+  m_open = true;
+#else
+  (void)fd;
+#endif
+}
+
+} // namespace utils
@@ -0,0 +1,56 @@
+/**
+  Read-only view of a whole file.
+
+  On POSIX systems the file is mmap'ed, so parsers can scan it in place
+  without copying it through an istream. Elsewhere the contents are read
+  into an owned buffer, which keeps the same interface.
+
+  A mapped file that is truncated while it is mapped raises SIGBUS on the
+  pages past its new end, so while files may be rewritten under the reader
+  (hot reload) they are always copied, see setFilesMayChange.
+  **/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace utils {
+
+class MappedFile {
+public: // interface
+  MappedFile() = default;
+  explicit MappedFile(std::string const &filePath);
+  ~MappedFile();
+
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  // copy instead of map from now on (or map again)
+  static void setFilesMayChange(bool mayChange);
+
+  bool isOpen() const;
+  explicit operator bool() const;
+
+  char const *data() const;
+  std::size_t size() const;
+  std::string_view view() const;
+
+private: // functions
+  void release();
+  void readCopy(int fd);
+
+private: // member variables
+  char const *m_data = nullptr;
+  std::size_t m_size = 0;
+  bool m_mapped = false;
+  bool m_open = false;
+  std::vector<char> m_fallback;
+};
+
+} // namespace utils
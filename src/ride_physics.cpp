@@ -0,0 +1,275 @@
+#include "ride_physics.hpp"
+
+#include "profiler.h"
+#include "track_analysis.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace modelling {
+
+namespace {
+
+// below this a train braking into a station counts as standing
+constexpr float kStopSpeed = 0.05f;
+// stations aim to stop this far short of their end
+constexpr float kStationMargin = 0.5f;
+
+} // namespace
+
+//
+// public interface
+//
+
+RidePhysics::RidePhysics(HermiteCurve const &curve,
+                         RidePhysicsSettings const &settings)
+    : m_settings(settings) {
+  PROFILE_ZONE("RidePhysics");
+  auto us = arcLengthGrid(curve, settings.spacing, settings.delta_u, &m_length);
+  auto n = us.size();
+  if (n < 2 || m_length <= 0.f)
+    return;
+
+  std::vector<vec3f> positions(n), firstDerivatives(n), secondDerivatives(n);
+  evaluateCubicHermiteBatch(curve, us.data(), n,
+                            positions.data(), firstDerivatives.data(),
+                            secondDerivatives.data());
+
+  m_slopes.resize(n + 1);
+  m_curvatures.resize(n);
+  size_t top = 0;
+  for (size_t i = 0; i < n; ++i) {
+    auto const &d1 = firstDerivatives[i];
+    auto const &d2 = secondDerivatives[i];
+    float speedU = glm::length(d1);
+    if (speedU <= 0.f)
+      continue;
+    vec3f tangent = d1 / speedU;
+    m_slopes[i] = tangent.y;
+    m_curvatures[i] =
+        glm::length(d2 - glm::dot(d2, tangent) * tangent) / (speedU * speedU);
+    if (positions[i].y > positions[top].y)
+      top = i;
+  }
+  m_slopes[n] = m_slopes[0];
+
+  // the grid ends short of the full length by less than a spacing, spread
+  // the entries evenly over the track instead
+  m_spacing = m_length / n;
+  m_inverseSpacing = 1.f / m_spacing;
+  m_topS = top * m_spacing;
+}
+
+void RidePhysics::setZones(TrackZones zones) { m_zones = std::move(zones); }
+
+TrackZones const &RidePhysics::zones() const { return m_zones; }
+
+void RidePhysics::setResistance(float friction, float drag) {
+  m_settings.friction = friction;
+  m_settings.drag = drag;
+}
+
+size_t RidePhysics::step(RideState &state, float dt) const {
+  if (m_curvatures.empty() || dt <= 0.f)
+    return 0;
+
+  // standing in a station
+  if (state.dwell > 0.f) {
+    state.dwell -= dt;
+    state.departing = state.dwell <= 0.f;
+    state.dwell = std::max(state.dwell, 0.f);
+    state.speed = 0.f;
+    state.phase = state.departing ? RidePhase::Boosting : RidePhase::Braking;
+    return 0;
+  }
+
+  // substeps from the distance covered this frame and the sharpest bend
+  // along it (a conservative guess at the distance, the speed may grow)
+  float distance = std::abs(state.speed) * dt + m_spacing;
+  float ahead = state.speed >= 0.f ? distance : -distance;
+  float curvature = state.speed >= 0.f
+                        ? maxCurvature(state.s, state.s + ahead)
+                        : maxCurvature(state.s + ahead, state.s);
+  float stepLength = m_settings.maxStepLength;
+  if (curvature > 0.f) {
+    stepLength = std::min(stepLength, m_settings.maxTurnPerStep / curvature);
+  }
+  auto substeps = std::clamp<size_t>(size_t(std::ceil(distance / stepLength)),
+                                     1, std::max<size_t>(m_settings.maxSubsteps, 1));
+  float h = dt / substeps;
+
+  float s = state.s, v = state.speed;
+  auto &cursor = state.cursor;
+  size_t taken = 0;
+  while (taken < substeps) {
+    ++taken;
+    float k1s = v;
+    float k1v = acceleration(s, v, cursor, state.departing);
+    float k2s = v + 0.5f * h * k1v;
+    float k2v =
+        acceleration(s + 0.5f * h * k1s, k2s, cursor, state.departing);
+    float k3s = v + 0.5f * h * k2v;
+    float k3v =
+        acceleration(s + 0.5f * h * k2s, k3s, cursor, state.departing);
+    float k4s = v + h * k3v;
+    float k4v = acceleration(s + h * k3s, k4s, cursor, state.departing);
+
+    s += h / 6.f * (k1s + 2.f * k2s + 2.f * k3s + k4s);
+    v += h / 6.f * (k1v + 2.f * k2v + 2.f * k3v + k4v);
+    s = wrap(s);
+
+    auto const *zone = m_zones.at(s, cursor);
+    if (!zone || zone->kind != ZoneKind::Station) {
+      state.departing = false;
+    }
+    if (!zone)
+      continue;
+
+    if (zone->kind == ZoneKind::Lift) {
+      // the chain's dogs only ever hold the train back from rolling slower
+      v = std::max(v, zone->speed);
+    } else if (zone->kind == ZoneKind::Booster ||
+               (zone->kind == ZoneKind::Station && state.departing)) {
+      // launch motors stop pushing at the zone's speed
+      if (v - h * zone->rate < zone->speed) {
+        v = std::min(v, zone->speed);
+      }
+    } else if (zone->kind == ZoneKind::Station && v <= kStopSpeed) {
+      v = 0.f;
+      state.dwell = zone->dwell;
+      state.departing = zone->dwell <= 0.f;
+      break;
+    }
+  }
+
+  state.s = s;
+  state.speed = v;
+  auto const *zone = m_zones.at(s, cursor);
+  if (!zone) {
+    state.phase = RidePhase::Coasting;
+  } else {
+    switch (zone->kind) {
+    case ZoneKind::Lift:
+      state.phase = RidePhase::Lift;
+      break;
+    case ZoneKind::Brake:
+      state.phase = RidePhase::Braking;
+      break;
+    case ZoneKind::Booster:
+      state.phase = RidePhase::Boosting;
+      break;
+    case ZoneKind::Station:
+      state.phase =
+          state.departing ? RidePhase::Boosting : RidePhase::Braking;
+      break;
+    }
+  }
+  return taken;
+}
+
+float RidePhysics::length() const { return m_length; }
+
+float RidePhysics::topS() const { return m_topS; }
+
+float RidePhysics::slopeAt(float s) const {
+  if (m_curvatures.empty())
+    return 0.f;
+  float x = wrap(s) * m_inverseSpacing;
+  auto index = std::min(size_t(x), m_curvatures.size() - 1);
+  float t = x - float(index);
+  return m_slopes[index] + t * (m_slopes[index + 1] - m_slopes[index]);
+}
+
+RidePhysicsSettings const &RidePhysics::settings() const { return m_settings; }
+
+//
+// private functions
+//
+
+float RidePhysics::acceleration(float s, float speed, ZoneCursor &cursor,
+                                bool departing) const {
+  float g = m_settings.gravity;
+  float slope = std::clamp(slopeAt(s), -1.f, 1.f);
+  float direction = speed > 0.f ? 1.f : speed < 0.f ? -1.f : 0.f;
+
+  float a = -g * slope;
+  a -= direction * m_settings.friction * g * std::sqrt(1.f - slope * slope);
+  a -= m_settings.drag * speed * std::abs(speed);
+
+  auto const *zone = m_zones.at(wrap(s), cursor);
+  if (!zone)
+    return a;
+
+  bool pushing = zone->kind == ZoneKind::Booster ||
+                 (zone->kind == ZoneKind::Station && departing);
+  if (pushing && speed < zone->speed) {
+    a += zone->rate;
+  } else if (zone->kind == ZoneKind::Brake ||
+             (zone->kind == ZoneKind::Station && !departing)) {
+    // the deceleration that reaches the zone's speed (a stop in stations)
+    // where the train leaves the zone, brakes hold a rolling back train too
+    float target = zone->kind == ZoneKind::Brake ? zone->speed : 0.f;
+    if (std::abs(speed) > target) {
+      float remaining = speed > 0.f ? wrap(zone->end - wrap(s))
+                                    : wrap(wrap(s) - zone->begin);
+      if (zone->kind == ZoneKind::Station) {
+        remaining -= kStationMargin;
+      }
+      float needed = remaining > 0.f ? (speed * speed - target * target) /
+                                           (2.f * remaining)
+                                     : zone->rate;
+      a -= direction * std::min(needed, zone->rate);
+    }
+  }
+  return a;
+}
+
+float RidePhysics::maxCurvature(float from, float to) const {
+  auto n = m_curvatures.size();
+  auto first = std::int64_t(std::floor(from * m_inverseSpacing));
+  auto last = std::int64_t(std::ceil(to * m_inverseSpacing));
+  last = std::min(last, first + std::int64_t(n));
+
+  float curvature = 0.f;
+  for (auto i = first; i <= last; ++i) {
+    auto index = size_t(((i % std::int64_t(n)) + std::int64_t(n)) %
+                        std::int64_t(n));
+    curvature = std::max(curvature, m_curvatures[index]);
+  }
+  return curvature;
+}
+
+float RidePhysics::wrap(float s) const {
+  if (s >= 0.f && s < m_length)
+    return s;
+  s = std::fmod(s, m_length);
+  if (s < 0.f)
+    s += m_length;
+  return s >= m_length ? 0.f : s;
+}
+
+//
+// free function interface
+//
+
+std::vector<TrackZone> defaultRideZones(RidePhysics const &physics,
+                                        float liftSpeed) {
+  float length = physics.length();
+  float top = physics.topS();
+  std::vector<TrackZone> zones;
+  if (length <= 0.f)
+    return zones;
+
+  if (top > 0.f) {
+    zones.push_back({ZoneKind::Lift, 0.f, top, liftSpeed});
+  }
+  float brakes = std::max(0.75f * length, top);
+  if (brakes < length) {
+    zones.push_back({ZoneKind::Brake, brakes, length, 2.f});
+  }
+  return zones;
+}
+
+} // namespace modelling
@@ -0,0 +1,104 @@
+/**
+  Arc-length dynamics of a train on a track.
+
+  The state is the arc length s and the speed along the track. The
+  acceleration along the track is
+    - gravity along the tangent, -g dy/ds
+    - rolling friction, -friction g sqrt(1 - (dy/ds)^2) in the direction
+      of travel
+    - drag, -drag v |v|
+    - the zone the train is in (see track_zones.hpp): brakes and stations
+      slow it down, boosters and departing stations push it up to speed
+  and a lift chain holds the train at no less than the zone's speed. A
+  train that comes to a stop in a station waits there for the zone's dwell
+  time before departing.
+
+  step() integrates with classic RK4. Each frame is split into substeps so
+  that no substep travels further than maxStepLength or turns through more
+  than maxTurnPerStep radians of the track's curvature, which keeps large
+  frame time steps accurate through tight elements and cheap on straights.
+
+  Slope and curvature are sampled from an arc-length grid built once per
+  track, so evaluating the acceleration is O(1).
+  **/
+
+#pragma once
+
+#include <vector>
+
+#include "hermite_curve.hpp"
+#include "track_zones.hpp"
+#include "trajectory_log.hpp"
+
+namespace modelling {
+
+struct RidePhysicsSettings {
+  float gravity = 10.f;         // as in utils::getDeltaSpeed
+  float friction = 0.f;         // rolling resistance coefficient
+  float drag = 0.f;             // per metre
+  float maxStepLength = 0.5f;   // metres per substep
+  float maxTurnPerStep = 0.05f; // radians per substep
+  size_t maxSubsteps = 64;
+  float spacing = 0.25f;        // of the slope and curvature grid
+  float delta_u = 0.00001f;     // integration step of the grid
+};
+
+struct RideState {
+  float s = 0.f;
+  float speed = 0.f;
+  RidePhase phase = RidePhase::Coasting;
+
+  ZoneCursor cursor;
+  float dwell = 0.f;      // seconds left standing in a station
+  bool departing = false; // until the train leaves the station
+};
+
+class RidePhysics {
+public: // interface
+  RidePhysics() = default;
+  explicit RidePhysics(HermiteCurve const &curve,
+                       RidePhysicsSettings const &settings = {});
+
+  void setZones(TrackZones zones);
+  TrackZones const &zones() const;
+
+  // friction and drag only enter the acceleration, the grid is kept
+  void setResistance(float friction, float drag);
+
+  // advances state by dt, returns the number of substeps taken
+  size_t step(RideState &state, float dt) const;
+
+  float length() const;
+  float topS() const; // arc length of the highest point
+  float slopeAt(float s) const;
+  RidePhysicsSettings const &settings() const;
+
+private: // functions
+  float acceleration(float s, float speed, ZoneCursor &cursor,
+                     bool departing) const;
+  float maxCurvature(float from, float to) const;
+  float wrap(float s) const;
+
+private: // member variables
+  RidePhysicsSettings m_settings;
+  TrackZones m_zones;
+
+  // dy/ds and curvature every spacing metres, one more slope entry than
+  // curvatures for wrapping
+  std::vector<float> m_slopes;
+  std::vector<float> m_curvatures;
+  float m_spacing = 1.f;
+  float m_inverseSpacing = 1.f;
+  float m_length = 0.f;
+  float m_topS = 0.f;
+};
+
+// free function interface
+
+// a lift from the start up to the highest point and brakes over the last
+// quarter of the track (where main used to brake) down to a crawl, for
+// tracks without a zones file
+std::vector<TrackZone> defaultRideZones(RidePhysics const &physics,
+                                        float liftSpeed = 10.f);
+
+} // namespace modelling
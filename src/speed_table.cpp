@@ -0,0 +1,128 @@
+#include "speed_table.hpp"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace modelling {
+
+//
+// public interface
+//
+
+SpeedTable::SpeedTable(float deltaS, std::vector<float> speeds, float topS)
+    : m_speeds(std::move(speeds)), m_deltaS(deltaS),
+      m_inverseDeltaS(1.f / deltaS), m_topS(topS) {}
+
+float SpeedTable::speedAt(float s) const { return interpolate(m_speeds, s); }
+
+float SpeedTable::topS() const { return m_topS; }
+
+float SpeedTable::deltaS() const { return m_deltaS; }
+
+float SpeedTable::length() const { return size() * m_deltaS; }
+
+size_t SpeedTable::size() const {
+  return m_speeds.empty() ? 0 : m_speeds.size() - 1;
+}
+
+//
+// private functions
+//
+
+float SpeedTable::interpolate(std::vector<float> const &values,
+                              float s) const {
+  auto n = size();
+  if (n == 0)
+    return 0.f;
+
+  float x = s * m_inverseDeltaS;
+  if (x < 0.f || x >= float(n)) {
+    x = std::fmod(x, float(n));
+    if (x < 0.f)
+      x += float(n);
+  }
+  auto index = std::min(size_t(x), n - 1);
+  float t = x - float(index);
+  return values[index] + t * (values[index + 1] - values[index]);
+}
+
+//
+// free function interface
+//
+
+SpeedTable calculateSpeedTable(HermiteCurve const &curve,
+                               ArcLengthTable const &arcLengthTable,
+                               float arcLength,
+                               SpeedTableSettings const &settings) {
+  PROFILE_ZONE("calculateSpeedTable");
+  if (arcLengthTable.size() == 0 || arcLength <= 0.f ||
+      curve.controlPoints().empty())
+    return {};
+
+  // track points at the table entries, in between heights are interpolated
+  // linearly as utils::getInterpolatedPoint does
+  std::vector<float> us(std::begin(arcLengthTable), std::end(arcLengthTable));
+  std::vector<vec3f> points(us.size());
+  evaluateCubicHermiteBatch(curve, us.data(), us.size(),
+                            points.data());
+  float tableDeltaS = arcLengthTable.deltaS();
+  auto heightAt = [&](float s) {
+    auto index = size_t(std::floor(s / tableDeltaS));
+    auto const &p = points[std::min(index, points.size() - 1)];
+    auto const &q = index + 1 < points.size() ? points[index + 1] : points[0];
+    return p.y + ((s - index * tableDeltaS) / tableDeltaS) * (q.y - p.y);
+  };
+
+  auto subdivisions = std::max<size_t>(settings.subdivisions, 1);
+  auto n = std::max<size_t>(
+      size_t(std::ceil(arcLength / tableDeltaS * subdivisions)), 2);
+  float deltaS = arcLength / n;
+
+  std::vector<float> heights(n);
+  size_t top = 0;
+  for (size_t i = 0; i < n; ++i) {
+    heights[i] = heightAt(i * deltaS);
+    if (heights[i] > heights[top])
+      top = i;
+  }
+
+  // the highest table point, as utils::getMaxPoint finds it
+  float topHeight = points.front().y;
+  for (auto const &p : points) {
+    topHeight = std::max(topHeight, p.y);
+  }
+  topHeight += settings.headroom;
+
+  // kinetic energy per unit mass, v^2 / 2; losses accumulate from the top
+  float g = settings.gravity;
+  float minimumEnergy = 0.5f * settings.minimumSpeed * settings.minimumSpeed;
+  bool lossless = settings.friction <= 0.f && settings.drag <= 0.f;
+  std::vector<float> speeds(n + 1);
+  float loss = 0.f;
+  for (size_t step = 0; step < n; ++step) {
+    auto i = (top + step) % n;
+    if (!lossless && step > 0) {
+      auto previous = (i + n - 1) % n;
+      float previousEnergy = 0.5f * speeds[previous] * speeds[previous];
+      float slope = std::clamp((heights[i] - heights[previous]) / deltaS,
+                               -1.f, 1.f);
+      loss += settings.friction * g * std::sqrt(1.f - slope * slope) * deltaS +
+              settings.drag * 2.f * previousEnergy * deltaS;
+    }
+
+    float energy = g * (topHeight - heights[i]) - loss;
+    if (energy < minimumEnergy) {
+      loss -= minimumEnergy - energy; // boosted back up
+      energy = minimumEnergy;
+    }
+    speeds[i] = std::sqrt(2.f * energy);
+  }
+  speeds[n] = speeds[0];
+
+  return SpeedTable(deltaS, std::move(speeds), top * deltaS);
+}
+
+} // namespace modelling
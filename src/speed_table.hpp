@@ -0,0 +1,65 @@
+/**
+  Speed of the train over arc length, precomputed alongside the
+  ArcLengthTable.
+
+  Without losses this is utils::getEnoughSpeed: the train crests the
+  highest point of the track with headroom metres of height to spare and
+  v = sqrt(2 g (top - y)). Friction (rolling resistance, times the normal
+  share of gravity) and drag (per metre, times v^2) are integrated once
+  around the track starting at the top, where a lift is assumed to restore
+  the energy lost over the lap. The speed never drops below minimumSpeed
+  (boosters keep the train moving where losses would stall it).
+
+  speedAt is a multiply and a linear interpolation, so sampling is O(1)
+  regardless of the track.
+  **/
+
+#pragma once
+
+#include <vector>
+
+#include "arc_length_parameterize.hpp"
+#include "hermite_curve.hpp"
+
+namespace modelling {
+
+struct SpeedTableSettings {
+  float gravity = 10.f;     // as in utils::getDeltaSpeed
+  float headroom = 5.f;     // above the highest point
+  float friction = 0.f;     // rolling resistance coefficient
+  float drag = 0.f;         // per metre, deceleration is drag * v^2
+  float minimumSpeed = 1.f; // floor where losses would stall the train
+  size_t subdivisions = 4;  // entries per arc-length table step
+};
+
+class SpeedTable {
+public: // interface
+  SpeedTable() = default;
+  SpeedTable(float deltaS, std::vector<float> speeds, float topS);
+
+  // speed along the track at arc length s (wraps around the track)
+  float speedAt(float s) const;
+
+  float topS() const; // arc length of the highest point
+  float deltaS() const;
+  float length() const;
+  size_t size() const;
+
+private: // functions
+  float interpolate(std::vector<float> const &values, float s) const;
+
+private: // member variables
+  // one entry more than size(), the last repeats the first for wrapping
+  std::vector<float> m_speeds;
+  float m_deltaS = 1.f;
+  float m_inverseDeltaS = 1.f;
+  float m_topS = 0.f;
+};
+
+// free function interface
+SpeedTable calculateSpeedTable(HermiteCurve const &curve,
+                               ArcLengthTable const &arcLengthTable,
+                               float arcLength,
+                               SpeedTableSettings const &settings = {});
+
+} // namespace modelling
@@ -0,0 +1,461 @@
+#include "streaming_track.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+//
+// streaming track format (.trks)
+//
+//   header (64 bytes)
+//     char[8]  magic "RCSTREAM"
+//     u32      version
+//     u32      segments per chunk
+//     u32      segment (control point) count
+//     u32      chunk count
+//     u32      arc-length table size
+//     f32      arc length
+//     f32      arc-length table delta s
+//     f32[3]   position of the first control point
+//     u64      FNV-1a checksum of the chunk index
+//     u64      file offset of the chunk index
+//   chunks, in order
+//     f32[count*6]  control points (position, tangent)
+//     f32[count]    arc-length table slice (u values)
+//   chunk index (last, the writer only knows it at the end), 32 bytes each
+//     u64      file offset
+//     u32      byte size
+//     u32      first segment
+//     u32      control point count
+//     u32      first table index
+//     u32      table entry count (including one entry of overlap)
+//     u32      low 32 bits of the FNV-1a checksum of the chunk
+//
+namespace modelling {
+
+using utils::byte_t;
+
+namespace {
+
+constexpr char kStreamMagic[8] = {'R', 'C', 'S', 'T', 'R', 'E', 'A', 'M'};
+constexpr std::uint32_t kStreamVersion = 2;
+constexpr size_t kStreamHeaderSize = 64;
+constexpr size_t kStreamIndexEntrySize = 32;
+
+// segment containing u, u outside of (0, 1) evaluates to the first control
+// point (see evaluateCubicHermite) and is filed under segment 0
+size_t segmentOf(float u, size_t segmentCount) {
+  if (u <= 0.f || u >= 1.f)
+    return 0;
+  return std::min(size_t(std::floor(segmentFrom(u, segmentCount))),
+                  segmentCount - 1);
+}
+
+} // namespace
+
+//
+// public interface
+//
+
+StreamingTrack::StreamingTrack(std::string const &filePath,
+                               size_t maxResidentChunks)
+    : m_file(filePath, std::ios::binary),
+      m_maxResident(std::max<size_t>(maxResidentChunks, 1)) {
+  if (!m_file) {
+    std::cerr << "Unable to open file " << filePath << '\n';
+    return;
+  }
+
+  auto error = [&](char const *what) {
+    std::cerr << "Error read streaming track " << filePath << ": " << what
+              << '\n';
+  };
+
+  byte_t header[kStreamHeaderSize];
+  if (!m_file.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+      std::memcmp(header, kStreamMagic, sizeof(kStreamMagic)) != 0) {
+    error("not a streaming track file");
+    return;
+  }
+  if (utils::getLE<std::uint32_t>(header + 8) != kStreamVersion) {
+    error("unsupported version");
+    return;
+  }
+
+  m_segmentCount = utils::getLE<std::uint32_t>(header + 16);
+  size_t chunkCount = utils::getLE<std::uint32_t>(header + 20);
+  m_tableCount = utils::getLE<std::uint32_t>(header + 24);
+  m_length = utils::getFloat(header + 28);
+  m_deltaS = utils::getFloat(header + 32);
+  m_origin = {utils::getFloat(header + 36), utils::getFloat(header + 40),
+              utils::getFloat(header + 44)};
+  auto checksum = utils::getLE<std::uint64_t>(header + 48);
+  auto indexOffset = utils::getLE<std::uint64_t>(header + 56);
+
+  // the index runs to the end of the file, checked before it is sized
+  m_file.seekg(0, std::ios::end);
+  std::uint64_t fileSize = std::uint64_t(m_file.tellg());
+  if (indexOffset < kStreamHeaderSize || indexOffset > fileSize ||
+      std::uint64_t(chunkCount) * kStreamIndexEntrySize !=
+          fileSize - indexOffset) {
+    error("corrupt chunk index");
+    return;
+  }
+  std::vector<byte_t> index(chunkCount * kStreamIndexEntrySize);
+  m_file.seekg(std::streamoff(indexOffset));
+  if (!m_file.read(reinterpret_cast<char *>(index.data()), index.size()) ||
+      utils::fnv1a(index.data(), index.size()) != checksum) {
+    error("corrupt chunk index");
+    return;
+  }
+
+  m_index.resize(chunkCount);
+  for (size_t i = 0; i < chunkCount; ++i) {
+    auto const *entry = index.data() + i * kStreamIndexEntrySize;
+    m_index[i] = {utils::getLE<std::uint64_t>(entry),
+                  utils::getLE<std::uint32_t>(entry + 8),
+                  utils::getLE<std::uint32_t>(entry + 12),
+                  utils::getLE<std::uint32_t>(entry + 16),
+                  utils::getLE<std::uint32_t>(entry + 20),
+                  utils::getLE<std::uint32_t>(entry + 24),
+                  utils::getLE<std::uint32_t>(entry + 28)};
+    auto const &info = m_index[i];
+    if (info.offset + info.byteSize > indexOffset ||
+        info.byteSize != (std::uint64_t(info.controlPointCount) * 6 +
+                          info.tableCount) *
+                             sizeof(float) ||
+        info.controlPointCount < 2 || info.tableCount < 1) {
+      error("corrupt chunk index");
+      m_index.clear();
+      return;
+    }
+  }
+
+  m_resident.reserve(m_maxResident);
+  m_open = m_tableCount > 0 && !m_index.empty();
+}
+
+bool StreamingTrack::isOpen() const { return m_open; }
+
+float StreamingTrack::length() const { return m_length; }
+
+float StreamingTrack::deltaS() const { return m_deltaS; }
+
+size_t StreamingTrack::chunkCount() const { return m_index.size(); }
+
+size_t StreamingTrack::residentChunkCount() const { return m_resident.size(); }
+
+size_t StreamingTrack::maxResidentChunks() const { return m_maxResident; }
+
+void StreamingTrack::prefetch(float s, float radius) {
+  if (!m_open)
+    return;
+
+  auto wrap = [&](float value) {
+    value = std::fmod(value, m_length);
+    return value < 0.f ? value + m_length : value;
+  };
+  auto tableIndex = [&](float value) {
+    return std::min(size_t(wrap(value) / m_deltaS), m_tableCount - 1);
+  };
+
+  auto first = chunkIndexFor(tableIndex(s - radius));
+  auto last = chunkIndexFor(tableIndex(s + radius));
+  for (size_t i = first;; i = (i + 1) % m_index.size()) {
+    residentChunk(i);
+    if (i == last)
+      break;
+  }
+}
+
+vec3f StreamingTrack::pointAt(float s) {
+  if (!m_open)
+    return m_origin;
+
+  // mirrors ArcLengthTable::nearestValueTo / nextValueTo
+  float index = std::floor(s / m_deltaS);
+  vec3f curve_p, curve_q;
+  if (index < 0.f || index >= float(m_tableCount)) {
+    // evaluate straight away, the second lookup may evict the first chunk
+    curve_p = evaluate(tableValue(m_tableCount - 1));
+    curve_q = evaluate(tableValue(0));
+  } else {
+    auto i = size_t(index);
+    auto &chunk = residentChunk(chunkIndexFor(i));
+    auto first = m_index[chunk.index].firstTableIndex;
+    // the last entry of every chunk overlaps the next one
+    curve_p = evaluate(chunk.table[i - first]);
+    curve_q = evaluate(chunk.table[i + 1 - first]);
+  }
+
+  return curve_p + ((s - index * m_deltaS) / m_deltaS) * (curve_q - curve_p);
+}
+
+//
+// private functions
+//
+
+size_t StreamingTrack::chunkIndexFor(size_t tableIndex) const {
+  auto iter = std::upper_bound(
+      std::begin(m_index), std::end(m_index), tableIndex,
+      [](size_t value, ChunkInfo const &info) {
+        return value < info.firstTableIndex;
+      });
+  return iter == std::begin(m_index) ? 0 : (iter - std::begin(m_index)) - 1;
+}
+
+StreamingTrack::Chunk &StreamingTrack::residentChunk(size_t chunkIndex) {
+  auto iter = std::find_if(
+      std::begin(m_resident), std::end(m_resident),
+      [&](Chunk const &chunk) { return chunk.index == chunkIndex; });
+  if (iter == std::end(m_resident)) {
+    return load(chunkIndex);
+  }
+  iter->lastUse = ++m_useCounter;
+  return *iter;
+}
+
+StreamingTrack::Chunk &StreamingTrack::load(size_t chunkIndex) {
+  auto const &info = m_index[chunkIndex];
+
+  std::vector<byte_t> bytes(info.byteSize);
+  m_file.clear();
+  m_file.seekg(std::streamoff(info.offset));
+  m_file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+  if (!m_file || std::uint32_t(utils::fnv1a(bytes.data(), bytes.size())) !=
+                     info.checksum) {
+    std::cerr << "Error read streaming track chunk " << chunkIndex << '\n';
+    std::fill(std::begin(bytes), std::end(bytes), 0);
+  }
+
+  // reuse the least recently used slot once the budget is reached
+  Chunk *chunk;
+  if (m_resident.size() < m_maxResident) {
+    m_resident.emplace_back();
+    chunk = &m_resident.back();
+  } else {
+    chunk = &*std::min_element(std::begin(m_resident), std::end(m_resident),
+                               [](Chunk const &a, Chunk const &b) {
+                                 return a.lastUse < b.lastUse;
+                               });
+  }
+
+  chunk->index = chunkIndex;
+  chunk->lastUse = ++m_useCounter;
+
+  std::vector<float> cpValues(info.controlPointCount * 6);
+  utils::getFloats(bytes.data(), cpValues.data(), cpValues.size());
+  chunk->cps.resize(info.controlPointCount);
+  for (size_t i = 0; i < info.controlPointCount; ++i) {
+    auto const *v = &cpValues[i * 6];
+    chunk->cps[i].position = {v[0], v[1], v[2]};
+    chunk->cps[i].tangent = {v[3], v[4], v[5]};
+  }
+
+  chunk->table.resize(info.tableCount);
+  utils::getFloats(bytes.data() + cpValues.size() * sizeof(float),
+                   chunk->table.data(), chunk->table.size());
+  return *chunk;
+}
+
+float StreamingTrack::tableValue(size_t tableIndex) {
+  auto &chunk = residentChunk(chunkIndexFor(tableIndex));
+  return chunk.table[tableIndex - m_index[chunk.index].firstTableIndex];
+}
+
+vec3f StreamingTrack::evaluate(float u) {
+  if (u <= 0.f || u >= 1.f)
+    return m_origin;
+
+  auto segment = segmentFrom(u, m_segmentCount);
+  auto index = segmentOf(u, m_segmentCount);
+
+  // any resident chunk holding both end points of the segment will do
+  for (auto const &chunk : m_resident) {
+    auto const &info = m_index[chunk.index];
+    if (index >= info.firstSegment &&
+        index + 1 < info.firstSegment + info.controlPointCount) {
+      auto local = index - info.firstSegment;
+      return evaluateCubicHermite(chunk.cps[local], chunk.cps[local + 1],
+                                  segment - std::floor(segment));
+    }
+  }
+  return m_origin; // not resident, callers always page the chunk in first
+}
+
+//
+// StreamingTrackWriter public interface
+//
+
+StreamingTrackWriter::StreamingTrackWriter(std::string const &filePath,
+                                           size_t segmentCount, float deltaS,
+                                           float delta_u,
+                                           size_t segmentsPerChunk)
+    : m_file(filePath, std::ios::binary), m_segmentCount(segmentCount),
+      m_segmentsPerChunk(std::max<size_t>(segmentsPerChunk, 1)),
+      m_deltaS(deltaS), m_deltaU(delta_u), m_offset(kStreamHeaderSize) {
+  assert(delta_u > 0.f);
+  // the header is written last, once the counts are known
+  m_file.seekp(std::streamoff(m_offset));
+  m_entries.push_back(0.f);
+}
+
+void StreamingTrackWriter::add(HermiteCurve::ControlPoint const &cp) {
+  if (m_added == m_segmentCount)
+    return;
+  if (m_head.size() < 2)
+    m_head.push_back(cp);
+  m_cps.push_back(cp);
+  ++m_added;
+  walk();
+}
+
+bool StreamingTrackWriter::finish() {
+  if (m_added != m_segmentCount || m_segmentCount == 0) {
+    std::cerr << "Streaming track: " << m_added << " of " << m_segmentCount
+              << " control points\n";
+    return false;
+  }
+  // the last segment ends at the first control point
+  m_cps.push_back(m_head.front());
+  walk();
+  writeChunk(0.f);
+
+  auto origin = m_head.front().position;
+  std::vector<byte_t> header(std::begin(kStreamMagic), std::end(kStreamMagic));
+  utils::putLE(header, kStreamVersion);
+  utils::putLE(header, std::uint32_t(m_segmentsPerChunk));
+  utils::putLE(header, std::uint32_t(m_segmentCount));
+  utils::putLE(header, std::uint32_t(m_chunkCount));
+  utils::putLE(header, std::uint32_t(m_firstEntry));
+  utils::putFloat(header, m_length);
+  utils::putFloat(header, m_deltaS);
+  utils::putFloat(header, origin.x);
+  utils::putFloat(header, origin.y);
+  utils::putFloat(header, origin.z);
+  utils::putLE(header, utils::fnv1a(m_index.data(), m_index.size()));
+  utils::putLE(header, m_offset);
+  header.resize(kStreamHeaderSize, 0);
+
+  m_file.write(reinterpret_cast<char const *>(m_index.data()), m_index.size());
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<char const *>(header.data()), header.size());
+  m_file.close();
+  return bool(m_file);
+}
+
+float StreamingTrackWriter::length() const { return m_length; }
+
+size_t StreamingTrackWriter::tableCount() const {
+  return m_firstEntry + m_entries.size();
+}
+
+size_t StreamingTrackWriter::chunkCount() const { return m_chunkCount; }
+
+size_t StreamingTrackWriter::residentControlPoints() const {
+  return m_cps.size();
+}
+
+//
+// StreamingTrackWriter private functions
+//
+
+HermiteCurve::ControlPoint const &
+StreamingTrackWriter::controlPoint(size_t index) const {
+  if (index >= m_firstResident && index - m_firstResident < m_cps.size())
+    return m_cps[index - m_firstResident];
+  // only chunks that wrap around the end reach back to the start
+  return m_head[(index % m_segmentCount) % m_head.size()];
+}
+
+bool StreamingTrackWriter::canEvaluate(float u) const {
+  if (u <= 0.f || u >= 1.f)
+    return true;
+  return segmentOf(u, m_segmentCount) + 1 < m_firstResident + m_cps.size();
+}
+
+vec3f StreamingTrackWriter::evaluate(float u) const {
+  if (u <= 0.f || u >= 1.f)
+    return m_head.front().position;
+  auto segment = segmentFrom(u, m_segmentCount);
+  auto index = segmentOf(u, m_segmentCount);
+  return evaluateCubicHermite(controlPoint(index), controlPoint(index + 1),
+                              segment - std::floor(segment));
+}
+
+// as far as the control points added so far allow
+void StreamingTrackWriter::walk() {
+  while (m_u < 1.f && canEvaluate(m_u) && canEvaluate(m_u + m_deltaU)) {
+    float step = glm::length(evaluate(m_u + m_deltaU) - evaluate(m_u));
+    m_accumulated += step;
+    m_length += step;
+    m_u += m_deltaU;
+    if (m_accumulated > m_deltaS) {
+      addEntry(m_u);
+      m_accumulated = 0.f;
+    }
+  }
+}
+
+void StreamingTrackWriter::addEntry(float u) {
+  auto chunk = segmentOf(u, m_segmentCount) / m_segmentsPerChunk;
+  if (chunk != m_chunk) {
+    writeChunk(u);
+    // the walk never goes back before the chunk it is in
+    auto keepFrom = std::min(chunk * m_segmentsPerChunk,
+                             segmentOf(u, m_segmentCount));
+    while (m_firstResident < keepFrom && m_cps.size() > 1) {
+      m_cps.pop_front();
+      ++m_firstResident;
+    }
+    m_chunk = chunk;
+  }
+  m_entries.push_back(u);
+}
+
+// the entries so far, plus one entry of overlap so that they can
+// interpolate to the next
+void StreamingTrackWriter::writeChunk(float overlap) {
+  if (m_entries.empty())
+    return;
+  std::vector<float> slice(m_entries);
+  slice.push_back(overlap);
+
+  auto firstSegment = std::min(m_chunk * m_segmentsPerChunk,
+                               segmentOf(m_entries.front(), m_segmentCount));
+  auto lastSegment = firstSegment;
+  for (auto u : slice) {
+    if (u > 0.f && u < 1.f)
+      lastSegment = std::max(lastSegment, segmentOf(u, m_segmentCount));
+  }
+  // control points [firstSegment, lastSegment + 1], wrapping at the end
+  auto cpCount = lastSegment - firstSegment + 2;
+
+  std::vector<byte_t> bytes;
+  for (size_t i = 0; i < cpCount; ++i) {
+    auto const &cp = controlPoint(firstSegment + i);
+    float cpValues[6] = {cp.position.x, cp.position.y, cp.position.z,
+                         cp.tangent.x,  cp.tangent.y,  cp.tangent.z};
+    utils::putFloats(bytes, cpValues, 6);
+  }
+  utils::putFloats(bytes, slice.data(), slice.size());
+  m_file.write(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+
+  utils::putLE(m_index, m_offset);
+  utils::putLE(m_index, std::uint32_t(bytes.size()));
+  utils::putLE(m_index, std::uint32_t(firstSegment));
+  utils::putLE(m_index, std::uint32_t(cpCount));
+  utils::putLE(m_index, std::uint32_t(m_firstEntry));
+  utils::putLE(m_index, std::uint32_t(slice.size()));
+  utils::putLE(m_index,
+               std::uint32_t(utils::fnv1a(bytes.data(), bytes.size())));
+
+  m_offset += bytes.size();
+  m_firstEntry += m_entries.size();
+  m_entries.clear();
+  ++m_chunkCount;
+}
+
+} // namespace modelling
@@ -0,0 +1,149 @@
+/**
+  Streaming access to tracks that are too long to keep expanded in memory.
+
+  StreamingTrackWriter builds the arc-length table while the control points
+  are fed to it one at a time (see forEachControlPoint), and writes the
+  track in chunks of a fixed number of curve segments as soon as a chunk is
+  complete. Each chunk holds the control points of its segments (plus the
+  overlap needed to evaluate across its end) and the slice of the
+  arc-length table whose entries fall into those segments. Neither side
+  ever holds more than a few chunks.
+
+  StreamingTrack only keeps the chunk index resident and pages chunks in on
+  demand, evicting the least recently used ones once maxResidentChunks is
+  reached. Call prefetch() for every train and the camera each frame so
+  the chunks around them are loaded before they are sampled.
+
+  Samples match utils::getInterpolatedPoint on the full track, with the
+  table calculateArcLengthTable builds for the same delta s and delta u.
+  **/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "arc_length_parameterize.hpp"
+#include "binary_io.hpp"
+#include "hermite_curve.hpp"
+
+namespace modelling {
+
+class StreamingTrack {
+public: // interface
+  explicit StreamingTrack(std::string const &filePath,
+                          size_t maxResidentChunks = 8);
+
+  bool isOpen() const;
+
+  float length() const;
+  float deltaS() const;
+  size_t chunkCount() const;
+  size_t residentChunkCount() const;
+  size_t maxResidentChunks() const;
+
+  // pages in the chunks covering [s - radius, s + radius]
+  void prefetch(float s, float radius);
+
+  // position on the track at arc length s (same as getInterpolatedPoint)
+  vec3f pointAt(float s);
+
+private: // types
+  struct ChunkInfo {
+    std::uint64_t offset;
+    std::uint32_t byteSize;
+    std::uint32_t firstSegment;
+    std::uint32_t controlPointCount;
+    std::uint32_t firstTableIndex;
+    std::uint32_t tableCount;
+    std::uint32_t checksum;
+  };
+
+  struct Chunk {
+    size_t index;
+    std::uint64_t lastUse = 0;
+    HermiteCurve::control_points cps;
+    ArcLengthTable::table_t table;
+  };
+
+private: // functions
+  size_t chunkIndexFor(size_t tableIndex) const;
+  Chunk &residentChunk(size_t chunkIndex);
+  Chunk &load(size_t chunkIndex);
+  float tableValue(size_t tableIndex);
+  vec3f evaluate(float u);
+
+private: // member variables
+  std::ifstream m_file;
+  std::vector<ChunkInfo> m_index;
+  std::vector<Chunk> m_resident;
+  size_t m_maxResident;
+  std::uint64_t m_useCounter = 0;
+
+  size_t m_segmentCount = 0;
+  size_t m_tableCount = 0;
+  float m_length = 0.f;
+  float m_deltaS = 1.f;
+  vec3f m_origin = vec3f(0.f);
+  bool m_open = false;
+};
+
+class StreamingTrackWriter {
+public: // interface
+  // the arc-length table gets an entry every deltaS, found in steps of
+  // delta_u (see calculateArcLengthTable)
+  StreamingTrackWriter(std::string const &filePath, size_t segmentCount,
+                       float deltaS, float delta_u,
+                       size_t segmentsPerChunk = 4096);
+
+  // in order, segmentCount of them
+  void add(HermiteCurve::ControlPoint const &cp);
+  // closes the curve and writes the index, false if the file is unusable
+  bool finish();
+
+  float length() const;
+  size_t tableCount() const;
+  size_t chunkCount() const;
+  size_t residentControlPoints() const;
+
+private: // functions
+  HermiteCurve::ControlPoint const &controlPoint(size_t index) const;
+  bool canEvaluate(float u) const;
+  vec3f evaluate(float u) const;
+  void walk();
+  void addEntry(float u);
+  void writeChunk(float overlap);
+
+private: // member variables
+  std::ofstream m_file;
+  size_t m_segmentCount;
+  size_t m_segmentsPerChunk;
+  float m_deltaS;
+  float m_deltaU;
+
+  // control points from m_firstResident on, the first two are kept for
+  // chunks that wrap around the end
+  std::deque<HermiteCurve::ControlPoint> m_cps;
+  size_t m_firstResident = 0;
+  size_t m_added = 0;
+  HermiteCurve::control_points m_head;
+
+  // the walk of calculateArcLengthTable
+  float m_u = 0.f;
+  float m_accumulated = 0.f;
+  float m_length = 0.f;
+
+  // table entries of the chunk being filled
+  std::vector<float> m_entries;
+  size_t m_chunk = 0;
+  size_t m_firstEntry = 0;
+
+  std::vector<utils::byte_t> m_index;
+  std::uint64_t m_offset;
+  size_t m_chunkCount = 0;
+};
+
+} // namespace modelling
@@ -0,0 +1,223 @@
+#include "track_analysis.hpp"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace modelling {
+
+namespace {
+
+// curve samples integrated per evaluateCubicHermiteBatch call
+constexpr size_t kGridBatch = 4096;
+
+using cell_key = std::uint64_t;
+
+cell_key cellKey(glm::ivec3 cell) {
+  auto bits = [](int v) { return std::uint64_t(std::uint32_t(v) & 0x1fffff); };
+  return bits(cell.x) << 42 | bits(cell.y) << 21 | bits(cell.z);
+}
+
+// distance to the closest sample more than 3 * radius away along the track,
+// capped at radius; samples are bucketed in a grid of radius sized cells
+std::vector<float> clearances(std::vector<vec3f> const &points, float spacing,
+                              float length, float radius) {
+  PROFILE_ZONE("clearances");
+  std::vector<float> result(points.size(), radius);
+  if (radius <= 0.f || points.empty())
+    return result;
+
+  auto cellOf = [&](vec3f const &p) {
+    return glm::ivec3(glm::floor(p / radius));
+  };
+  std::vector<std::pair<cell_key, std::uint32_t>> cells;
+  cells.reserve(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    cells.emplace_back(cellKey(cellOf(points[i])), std::uint32_t(i));
+  }
+  std::sort(std::begin(cells), std::end(cells));
+
+  float exclusion = 3.f * radius;
+  for (size_t i = 0; i < points.size(); ++i) {
+    auto cell = cellOf(points[i]);
+    float best = radius * radius;
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dz = -1; dz <= 1; ++dz) {
+          auto key = cellKey(cell + glm::ivec3(dx, dy, dz));
+          auto it = std::lower_bound(
+              std::begin(cells), std::end(cells), key,
+              [](auto const &entry, cell_key k) { return entry.first < k; });
+          for (; it != std::end(cells) && it->first == key; ++it) {
+            float along = std::abs(float(i) - float(it->second)) * spacing;
+            along = std::min(along, length - along);
+            if (along <= exclusion)
+              continue;
+            vec3f d = points[i] - points[it->second];
+            best = std::min(best, glm::dot(d, d));
+          }
+        }
+      }
+    }
+    result[i] = std::sqrt(best);
+  }
+  return result;
+}
+
+} // namespace
+
+//
+// free function interface
+//
+
+std::vector<float> arcLengthGrid(HermiteCurve const &curve, float spacing,
+                                 float delta_u, float *length) {
+  PROFILE_ZONE("arcLengthGrid");
+  std::vector<float> grid;
+  auto const &cps = curve.controlPoints();
+  if (cps.empty() || spacing <= 0.f || delta_u <= 0.f) {
+    if (length)
+      *length = 0.f;
+    return grid;
+  }
+
+  // uniform steps in u, the last one ends at u = 1 (back at the start)
+  auto steps = size_t(std::ceil(1.0 / delta_u));
+  std::vector<float> us(kGridBatch + 1);
+  std::vector<vec3f> points(kGridBatch + 1);
+
+  grid.push_back(0.f);
+  double travelled = 0.0;
+  for (size_t first = 0; first < steps; first += kGridBatch) {
+    auto count = std::min(kGridBatch, steps - first);
+    for (size_t i = 0; i <= count; ++i) {
+      us[i] = float(double(first + i) / steps);
+    }
+    evaluateCubicHermiteBatch(curve, us.data(), count + 1, points.data());
+
+    for (size_t i = 0; i < count; ++i) {
+      double step = glm::length(points[i + 1] - points[i]);
+      // every grid point within this step, interpolated linearly in u
+      for (double next = grid.size() * double(spacing);
+           step > 0.0 && next <= travelled + step;
+           next = grid.size() * double(spacing)) {
+        double t = (next - travelled) / step;
+        grid.push_back(float(us[i] + t * (us[i + 1] - us[i])));
+      }
+      travelled += step;
+    }
+  }
+
+  // the curve is closed, a point at the very end repeats the start
+  while (grid.size() > 1 &&
+         (grid.size() - 1) * double(spacing) > travelled - 1e-3 * spacing) {
+    grid.pop_back();
+  }
+  if (length)
+    *length = float(travelled);
+  return grid;
+}
+
+TrackProfile analyzeTrack(HermiteCurve const &curve,
+                          TrackAnalysisSettings const &settings) {
+  PROFILE_ZONE("analyzeTrack");
+  TrackProfile profile;
+  profile.spacing = settings.spacing;
+  profile.u = arcLengthGrid(curve, settings.spacing, settings.delta_u,
+                            &profile.length);
+
+  auto n = profile.u.size();
+  if (n == 0)
+    return profile;
+
+  std::vector<vec3f> positions(n), firstDerivatives(n), secondDerivatives(n);
+  evaluateCubicHermiteBatch(curve, profile.u.data(), n,
+                            positions.data(), firstDerivatives.data(),
+                            secondDerivatives.data());
+
+  float top = positions.front().y;
+  for (auto const &p : positions) {
+    top = std::max(top, p.y);
+  }
+  top += settings.headroom;
+
+  profile.s.resize(n);
+  profile.height.resize(n);
+  profile.speed.resize(n);
+  profile.normalG.resize(n);
+  profile.lateralG.resize(n);
+
+  float g = settings.gravity;
+  vec3f const up(0.f, 1.f, 0.f);
+  vec3f tangent(0.f, 0.f, 1.f), lateral(1.f, 0.f, 0.f);
+  for (size_t i = 0; i < n; ++i) {
+    auto const &p = positions[i];
+    auto const &d1 = firstDerivatives[i];
+    auto const &d2 = secondDerivatives[i];
+
+    float speed2 = 2.f * g * std::max(0.f, top - p.y);
+    profile.s[i] = i * settings.spacing;
+    profile.height[i] = p.y;
+    profile.speed[i] = std::sqrt(speed2);
+
+    // a = v^2 k N; without friction the tangential acceleration is exactly
+    // gravity's, so the felt force v^2 k N - gravity has no tangential part
+    float speedU = glm::length(d1);
+    if (speedU > 0.f) {
+      tangent = d1 / speedU;
+    }
+    vec3f curvature = speedU > 0.f
+                          ? (d2 - glm::dot(d2, tangent) * tangent) /
+                                (speedU * speedU)
+                          : vec3f(0.f);
+    vec3f felt = speed2 * curvature + g * (up - tangent.y * tangent);
+
+    // keep the previous side on vertical stretches
+    vec3f side = glm::cross(tangent, up);
+    if (glm::length(side) > 1e-4f) {
+      lateral = glm::normalize(side);
+    }
+    vec3f trackUp = glm::cross(lateral, tangent);
+
+    profile.normalG[i] = glm::dot(felt, trackUp) / g;
+    profile.lateralG[i] = glm::dot(felt, lateral) / g;
+  }
+
+  profile.clearance = clearances(positions, settings.spacing, profile.length,
+                                 settings.clearanceRadius);
+  return profile;
+}
+
+TrackProfileSummary summarize(TrackProfile const &profile) {
+  TrackProfileSummary summary;
+  summary.length = profile.length;
+  summary.samples = profile.size();
+  if (profile.size() == 0)
+    return summary;
+
+  auto [minHeight, maxHeight] =
+      std::minmax_element(std::begin(profile.height), std::end(profile.height));
+  auto [minNormal, maxNormal] = std::minmax_element(
+      std::begin(profile.normalG), std::end(profile.normalG));
+  auto minClearance = std::min_element(std::begin(profile.clearance),
+                                       std::end(profile.clearance));
+
+  summary.minHeight = *minHeight;
+  summary.maxHeight = *maxHeight;
+  summary.maxSpeed =
+      *std::max_element(std::begin(profile.speed), std::end(profile.speed));
+  summary.minNormalG = *minNormal;
+  summary.maxNormalG = *maxNormal;
+  for (auto lateral : profile.lateralG) {
+    summary.maxLateralG = std::max(summary.maxLateralG, std::abs(lateral));
+  }
+  summary.minClearance = *minClearance;
+  summary.minClearanceS =
+      profile.s[size_t(minClearance - std::begin(profile.clearance))];
+  return summary;
+}
+
+} // namespace modelling
@@ -0,0 +1,74 @@
+/**
+  Ride profiles along a track for safety review.
+
+  analyzeTrack samples the track on a dense, evenly spaced arc-length grid
+  and evaluates at every sample:
+    - height (y)
+    - speed by energy conservation from the highest point plus headroom,
+      as the simulation does (see utils::getEnoughSpeed)
+    - the force felt by a rider in g, split into the normal component
+      (towards the track's up, 1 on a flat straight) and the lateral one
+      (sideways, horizontal); the track is treated as unbanked
+    - clearance, the distance to the closest part of the track that is
+      further away along the track (capped at clearanceRadius)
+
+  Curve positions and derivatives come from evaluateCubicHermiteBatch, so
+  curvature is exact rather than a finite difference of table points.
+  **/
+
+#pragma once
+
+#include <vector>
+
+#include "hermite_curve.hpp"
+
+namespace modelling {
+
+struct TrackAnalysisSettings {
+  float spacing = 0.1f;         // arc length between samples
+  float delta_u = 0.00001f;     // integration step of the arc-length grid
+  float headroom = 5.f;         // above the highest point (as in main)
+  float gravity = 10.f;         // as in utils::getDeltaSpeed
+  float clearanceRadius = 10.f; // search radius for clearance
+};
+
+// structure of arrays, one entry per sample
+struct TrackProfile {
+  float length = 0.f;
+  float spacing = 0.f;
+  std::vector<float> s;
+  std::vector<float> u;
+  std::vector<float> height;
+  std::vector<float> speed;
+  std::vector<float> normalG;
+  std::vector<float> lateralG;
+  std::vector<float> clearance;
+
+  size_t size() const { return s.size(); }
+};
+
+struct TrackProfileSummary {
+  float length = 0.f;
+  size_t samples = 0;
+  float minHeight = 0.f;
+  float maxHeight = 0.f;
+  float maxSpeed = 0.f;
+  float minNormalG = 0.f;
+  float maxNormalG = 0.f;
+  float maxLateralG = 0.f; // absolute
+  float minClearance = 0.f;
+  float minClearanceS = 0.f;
+};
+
+// free function interface
+
+// parameters u_i with arc length i * spacing from the start of the curve
+std::vector<float> arcLengthGrid(HermiteCurve const &curve, float spacing,
+                                 float delta_u, float *length = nullptr);
+
+TrackProfile analyzeTrack(HermiteCurve const &curve,
+                          TrackAnalysisSettings const &settings = {});
+
+TrackProfileSummary summarize(TrackProfile const &profile);
+
+} // namespace modelling
@@ -0,0 +1,213 @@
+#include "track_zones.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+namespace modelling {
+
+namespace {
+
+std::optional<ZoneKind> zoneKindFrom(std::string const &name) {
+  if (name == "lift")
+    return ZoneKind::Lift;
+  if (name == "brake")
+    return ZoneKind::Brake;
+  if (name == "booster")
+    return ZoneKind::Booster;
+  if (name == "station")
+    return ZoneKind::Station;
+  return std::nullopt;
+}
+
+// metres, or percent of the track length with a trailing '%'
+std::optional<float> parsePosition(std::string const &token,
+                                   float trackLength) {
+  try {
+    size_t used = 0;
+    float value = std::stof(token, &used);
+    if (used == token.size())
+      return value;
+    if (used + 1 == token.size() && token.back() == '%')
+      return value * 0.01f * trackLength;
+  } catch (std::exception const &) {
+  }
+  return std::nullopt;
+}
+
+} // namespace
+
+//
+// public interface
+//
+
+TrackZones::TrackZones(std::vector<TrackZone> zones, float trackLength)
+    : m_zones(std::move(zones)), m_trackLength(trackLength) {
+  for (size_t i = 0; i < m_zones.size(); ++i) {
+    auto const &zone = m_zones[i];
+    float begin = std::clamp(zone.begin, 0.f, trackLength);
+    float end = std::clamp(zone.end, 0.f, trackLength);
+    if (begin < end) {
+      m_intervals.push_back({begin, end, i});
+    } else if (begin > end) {
+      m_intervals.push_back({begin, trackLength, i});
+      m_intervals.push_back({0.f, end, i});
+    }
+  }
+  std::sort(std::begin(m_intervals), std::end(m_intervals),
+            [](auto const &a, auto const &b) { return a.begin < b.begin; });
+
+  // the zone listed first keeps an overlapping stretch
+  for (size_t i = 1; i < m_intervals.size(); ++i) {
+    auto &previous = m_intervals[i - 1];
+    auto &current = m_intervals[i];
+    if (current.begin < previous.end) {
+      std::cerr << "Track zones " << zoneKindName(m_zones[previous.zone].kind)
+                << " and " << zoneKindName(m_zones[current.zone].kind)
+                << " overlap at " << current.begin << '\n';
+      if (previous.zone < current.zone) {
+        current.begin = std::min(previous.end, current.end);
+      } else {
+        previous.end = current.begin;
+      }
+    }
+  }
+  m_intervals.erase(std::remove_if(std::begin(m_intervals),
+                                   std::end(m_intervals),
+                                   [](auto const &interval) {
+                                     return interval.begin >= interval.end;
+                                   }),
+                    std::end(m_intervals));
+}
+
+TrackZone const *TrackZones::at(float s) const {
+  // last interval beginning at or before s
+  auto it = std::upper_bound(
+      std::begin(m_intervals), std::end(m_intervals), s,
+      [](float value, Interval const &interval) {
+        return value < interval.begin;
+      });
+  if (it == std::begin(m_intervals))
+    return nullptr;
+  --it;
+  return s < it->end ? &m_zones[it->zone] : nullptr;
+}
+
+TrackZone const *TrackZones::at(float s, ZoneCursor &cursor) const {
+  auto n = m_intervals.size();
+  if (n == 0)
+    return nullptr;
+
+  // trains mostly stay put or move on to the next interval (or gap)
+  auto current = std::min(cursor.interval, n - 1);
+  auto next = current + 1 < n ? current + 1 : 0;
+  bool beforeNext = next == 0 ? s >= m_intervals[current].begin
+                              : s >= m_intervals[current].begin &&
+                                    s < m_intervals[next].begin;
+  if (contains(current, s) || (beforeNext && s >= m_intervals[current].end)) {
+    cursor.interval = current;
+    return contains(current, s) ? &m_zones[m_intervals[current].zone]
+                                : nullptr;
+  }
+  if (contains(next, s)) {
+    cursor.interval = next;
+    return &m_zones[m_intervals[next].zone];
+  }
+
+  auto it = std::upper_bound(
+      std::begin(m_intervals), std::end(m_intervals), s,
+      [](float value, Interval const &interval) {
+        return value < interval.begin;
+      });
+  // before the first interval, the gap belongs to the last one (wrapping)
+  cursor.interval = it == std::begin(m_intervals)
+                        ? n - 1
+                        : size_t(it - std::begin(m_intervals)) - 1;
+  return contains(cursor.interval, s) ? &m_zones[m_intervals[cursor.interval].zone]
+                                      : nullptr;
+}
+
+std::vector<TrackZone> const &TrackZones::zones() const { return m_zones; }
+
+bool TrackZones::empty() const { return m_zones.empty(); }
+
+float TrackZones::trackLength() const { return m_trackLength; }
+
+//
+// private functions
+//
+
+bool TrackZones::contains(size_t interval, float s) const {
+  auto const &i = m_intervals[interval];
+  return s >= i.begin && s < i.end;
+}
+
+//
+// free function interface
+//
+
+std::string zonesPathFor(std::string const &trackPath) {
+  auto dot = trackPath.find_last_of('.');
+  auto slash = trackPath.find_last_of("/\\");
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash))
+    return trackPath + ".zones";
+  return trackPath.substr(0, dot) + ".zones";
+}
+
+std::optional<std::vector<TrackZone>>
+readTrackZones(std::string const &filePath, float trackLength) {
+  std::ifstream file(filePath);
+  if (!file)
+    return std::nullopt;
+
+  std::vector<TrackZone> zones;
+  std::string line;
+  size_t lineNum = 0;
+  while (std::getline(file, line)) {
+    ++lineNum;
+    line = line.substr(0, line.find('#'));
+    std::istringstream in(line);
+    std::string kindName, beginToken, endToken;
+    if (!(in >> kindName))
+      continue;
+
+    auto kind = zoneKindFrom(kindName);
+    TrackZone zone{ZoneKind::Lift, 0.f, 0.f, 0.f};
+    std::optional<float> begin, end;
+    if (kind && in >> beginToken >> endToken >> zone.speed) {
+      begin = parsePosition(beginToken, trackLength);
+      end = parsePosition(endToken, trackLength);
+    }
+    if (!kind || !begin || !end) {
+      std::cerr << "Error read file: " << line << " (line: " << lineNum
+                << ")\n";
+      continue;
+    }
+
+    zone.kind = *kind;
+    zone.begin = *begin;
+    zone.end = *end;
+    in >> zone.rate >> zone.dwell; // optional, defaults stay otherwise
+    zones.push_back(zone);
+  }
+  return zones;
+}
+
+char const *zoneKindName(ZoneKind kind) {
+  switch (kind) {
+  case ZoneKind::Lift:
+    return "lift";
+  case ZoneKind::Brake:
+    return "brake";
+  case ZoneKind::Booster:
+    return "booster";
+  case ZoneKind::Station:
+    return "station";
+  }
+  return "unknown";
+}
+
+} // namespace modelling
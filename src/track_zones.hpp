@@ -0,0 +1,92 @@
+/**
+  Zones along a track that act on the trains: chain lifts, brakes, launch
+  boosters and stations.
+
+  TrackZones keeps the zones as sorted, non-overlapping intervals over arc
+  length (zones that wrap past the end of the track are split in two), so
+  the zone at s is a binary search. Trains move along the track, so each
+  keeps a ZoneCursor: lookups from a cursor check the interval it points at
+  and its successor before falling back to the search, which makes the
+  common case O(1).
+
+  Zones are read from a sidecar next to the track file (see zonesPathFor),
+  one zone per line, '#' starts a comment:
+
+    # kind     begin  end   speed  [rate]  [dwell]
+    lift       0      115   10
+    booster    300    320   30     15
+    brake      75%    100%  2      6
+    station    780    800   5      3       10
+
+  begin and end are metres of arc length, or percent of the track length.
+    lift     holds the train at no less than speed
+    booster  accelerates at rate (m/s^2) up to speed
+    brake    decelerates (at most rate) to reach speed by the end
+    station  brakes (at most rate) to a stop by the end, waits dwell
+             seconds and sends the train off at speed
+  **/
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace modelling {
+
+enum class ZoneKind { Lift, Brake, Booster, Station };
+
+struct TrackZone {
+  ZoneKind kind;
+  float begin; // arc length, begin > end wraps around the start
+  float end;
+  float speed;
+  float rate = 6.f;  // acceleration or deceleration limit
+  float dwell = 0.f; // stations only
+};
+
+// where a train last found its zone, one per train
+struct ZoneCursor {
+  size_t interval = 0;
+};
+
+class TrackZones {
+public: // interface
+  TrackZones() = default;
+  TrackZones(std::vector<TrackZone> zones, float trackLength);
+
+  // zone at s in [0, trackLength), nullptr between zones
+  TrackZone const *at(float s) const;
+  TrackZone const *at(float s, ZoneCursor &cursor) const;
+
+  std::vector<TrackZone> const &zones() const;
+  bool empty() const;
+  float trackLength() const;
+
+private: // types
+  struct Interval {
+    float begin;
+    float end;
+    size_t zone;
+  };
+
+private: // functions
+  bool contains(size_t interval, float s) const;
+
+private: // member variables
+  std::vector<TrackZone> m_zones;
+  std::vector<Interval> m_intervals; // sorted by begin
+  float m_trackLength = 0.f;
+};
+
+// free function interface
+
+// <track without extension>.zones
+std::string zonesPathFor(std::string const &trackPath);
+
+std::optional<std::vector<TrackZone>>
+readTrackZones(std::string const &filePath, float trackLength);
+
+char const *zoneKindName(ZoneKind kind);
+
+} // namespace modelling
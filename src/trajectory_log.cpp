@@ -0,0 +1,355 @@
+#include "trajectory_log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+//
+// trajectory log format (.rctraj)
+//
+//   header (64 bytes)
+//     char[8]  magic "RCTRAJEC"
+//     u32      version
+//     u32      samples per chunk
+//     u32      position scale (fixed-point units per metre)
+//     u32      speed scale (fixed-point units per metre/second)
+//     f32      time step (seconds)
+//     f32      track length
+//     u64      sample count
+//     u64      chunk index offset
+//     u32      chunk count
+//     u32      reserved
+//     u64      FNV-1a checksum of the chunk index
+//   chunks, every field a varint of a zig-zag encoded fixed-point value
+//     first sample   s, speed << 2 | phase
+//     later samples  change in the step s - previous s,
+//                    change in speed << 2 | phase
+//   chunk index, 16 bytes per chunk
+//     u64      file offset
+//     u32      byte size
+//     u32      low 32 bits of the FNV-1a checksum of the chunk
+//
+// Steps along the track barely change from one simulation step to the next,
+// so most samples take two or three bytes.
+//
+namespace modelling {
+
+using utils::byte_t;
+
+namespace {
+
+constexpr char kTrajectoryMagic[8] = {'R', 'C', 'T', 'R', 'A', 'J', 'E', 'C'};
+constexpr std::uint32_t kTrajectoryVersion = 1;
+constexpr size_t kTrajectoryHeaderSize = 64;
+constexpr size_t kTrajectoryIndexEntrySize = 16;
+constexpr std::uint32_t kPositionScale = 10000;
+constexpr std::uint32_t kSpeedScale = 10000;
+
+std::vector<byte_t> header(std::uint32_t samplesPerChunk, float timeStep,
+                           float trackLength, std::uint64_t sampleCount,
+                           std::uint64_t indexOffset,
+                           std::vector<byte_t> const &index) {
+  std::vector<byte_t> bytes(std::begin(kTrajectoryMagic),
+                            std::end(kTrajectoryMagic));
+  utils::putLE(bytes, kTrajectoryVersion);
+  utils::putLE(bytes, samplesPerChunk);
+  utils::putLE(bytes, kPositionScale);
+  utils::putLE(bytes, kSpeedScale);
+  utils::putFloat(bytes, timeStep);
+  utils::putFloat(bytes, trackLength);
+  utils::putLE(bytes, sampleCount);
+  utils::putLE(bytes, indexOffset);
+  utils::putLE(bytes,
+               std::uint32_t(index.size() / kTrajectoryIndexEntrySize));
+  utils::putLE(bytes, std::uint32_t(0));
+  utils::putLE(bytes, utils::fnv1a(index.data(), index.size()));
+  bytes.resize(kTrajectoryHeaderSize, 0);
+  return bytes;
+}
+
+} // namespace
+
+//
+// recording
+//
+
+TrajectoryRecorder::TrajectoryRecorder(std::string const &filePath,
+                                       float timeStep, float trackLength,
+                                       size_t samplesPerChunk)
+    : m_file(filePath, std::ios::binary), m_timeStep(timeStep),
+      m_trackLength(trackLength),
+      m_samplesPerChunk(std::max<size_t>(samplesPerChunk, 1)) {
+  if (!m_file) {
+    std::cerr << "Unable to open file " << filePath << '\n';
+    return;
+  }
+  // the header is rewritten by finish() once the counts are known
+  auto bytes = header(0, m_timeStep, m_trackLength, 0, 0, {});
+  m_file.write(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+  m_offset = bytes.size();
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() { finish(); }
+
+bool TrajectoryRecorder::isOpen() const { return bool(m_file); }
+
+size_t TrajectoryRecorder::sampleCount() const { return m_sampleCount; }
+
+void TrajectoryRecorder::record(TrajectorySample const &sample) {
+  if (m_finished || !m_file)
+    return;
+
+  auto s = std::int64_t(std::llround(double(sample.s) * kPositionScale));
+  auto speed = std::int64_t(std::llround(double(sample.speed) * kSpeedScale));
+  auto phase = std::uint64_t(sample.phase) & 3;
+
+  if (m_chunkSamples == 0) {
+    // chunks start from absolute values so they decode on their own
+    utils::putVarint(m_chunk, utils::zigZag(s));
+    utils::putVarint(m_chunk, utils::zigZag(speed) << 2 | phase);
+    m_step = 0;
+  } else {
+    auto step = s - m_s;
+    utils::putVarint(m_chunk, utils::zigZag(step - m_step));
+    utils::putVarint(m_chunk, utils::zigZag(speed - m_speed) << 2 | phase);
+    m_step = step;
+  }
+  m_s = s;
+  m_speed = speed;
+  ++m_sampleCount;
+
+  if (++m_chunkSamples == m_samplesPerChunk) {
+    flushChunk();
+  }
+}
+
+void TrajectoryRecorder::finish() {
+  if (m_finished || !m_file)
+    return;
+  m_finished = true;
+  flushChunk();
+
+  std::vector<byte_t> index;
+  index.reserve(m_index.size() * kTrajectoryIndexEntrySize);
+  for (auto const &chunk : m_index) {
+    utils::putLE(index, chunk.offset);
+    utils::putLE(index, chunk.byteSize);
+    utils::putLE(index, chunk.checksum);
+  }
+  m_file.write(reinterpret_cast<char const *>(index.data()), index.size());
+
+  auto bytes = header(std::uint32_t(m_samplesPerChunk), m_timeStep,
+                      m_trackLength, m_sampleCount, m_offset, index);
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+  m_file.close();
+}
+
+void TrajectoryRecorder::flushChunk() {
+  if (m_chunkSamples == 0)
+    return;
+
+  m_file.write(reinterpret_cast<char const *>(m_chunk.data()), m_chunk.size());
+  m_index.push_back(
+      {m_offset, std::uint32_t(m_chunk.size()),
+       std::uint32_t(utils::fnv1a(m_chunk.data(), m_chunk.size()))});
+  m_offset += m_chunk.size();
+  m_chunk.clear();
+  m_chunkSamples = 0;
+}
+
+//
+// replay
+//
+
+TrajectoryReplay::TrajectoryReplay(std::string const &filePath)
+    : m_file(filePath, std::ios::binary), m_filePath(filePath) {
+  if (!m_file) {
+    std::cerr << "Unable to open file " << filePath << '\n';
+    return;
+  }
+
+  auto error = [&](char const *what) {
+    std::cerr << "Error read trajectory " << filePath << ": " << what << '\n';
+  };
+
+  byte_t header[kTrajectoryHeaderSize];
+  if (!m_file.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+      std::memcmp(header, kTrajectoryMagic, sizeof(kTrajectoryMagic)) != 0) {
+    error("not a trajectory file");
+    return;
+  }
+  if (utils::getLE<std::uint32_t>(header + 8) != kTrajectoryVersion) {
+    error("unsupported version");
+    return;
+  }
+
+  m_samplesPerChunk = utils::getLE<std::uint32_t>(header + 12);
+  m_positionScale = float(utils::getLE<std::uint32_t>(header + 16));
+  m_speedScale = float(utils::getLE<std::uint32_t>(header + 20));
+  m_timeStep = utils::getFloat(header + 24);
+  m_trackLength = utils::getFloat(header + 28);
+  m_sampleCount = utils::getLE<std::uint64_t>(header + 32);
+  auto indexOffset = utils::getLE<std::uint64_t>(header + 40);
+  size_t chunkCount = utils::getLE<std::uint32_t>(header + 48);
+  auto checksum = utils::getLE<std::uint64_t>(header + 56);
+
+  if (m_samplesPerChunk == 0 ||
+      chunkCount != (m_sampleCount + m_samplesPerChunk - 1) /
+                        m_samplesPerChunk) {
+    error("inconsistent header (was the recording finished?)");
+    return;
+  }
+
+  // the index runs to the end of the file, checked before it is sized
+  m_file.seekg(0, std::ios::end);
+  std::uint64_t fileSize = std::uint64_t(m_file.tellg());
+  if (indexOffset < kTrajectoryHeaderSize || indexOffset > fileSize ||
+      std::uint64_t(chunkCount) * kTrajectoryIndexEntrySize !=
+          fileSize - indexOffset) {
+    error("corrupt chunk index");
+    return;
+  }
+  std::vector<byte_t> index(chunkCount * kTrajectoryIndexEntrySize);
+  m_file.seekg(std::streamoff(indexOffset));
+  if (!m_file.read(reinterpret_cast<char *>(index.data()), index.size()) ||
+      utils::fnv1a(index.data(), index.size()) != checksum) {
+    error("corrupt chunk index");
+    return;
+  }
+
+  m_index.resize(chunkCount);
+  for (size_t i = 0; i < chunkCount; ++i) {
+    auto const *entry = index.data() + i * kTrajectoryIndexEntrySize;
+    m_index[i] = {utils::getLE<std::uint64_t>(entry),
+                  utils::getLE<std::uint32_t>(entry + 8),
+                  utils::getLE<std::uint32_t>(entry + 12)};
+    // chunks lie between the header and the index, so decode() never sizes
+    // a buffer from a bad entry
+    auto const &chunk = m_index[i];
+    if (chunk.offset < kTrajectoryHeaderSize || chunk.offset > indexOffset ||
+        chunk.byteSize > indexOffset - chunk.offset) {
+      error("corrupt chunk index");
+      return;
+    }
+  }
+
+  m_open = m_sampleCount > 0;
+}
+
+bool TrajectoryReplay::isOpen() const { return m_open; }
+
+size_t TrajectoryReplay::sampleCount() const { return m_sampleCount; }
+
+float TrajectoryReplay::timeStep() const { return m_timeStep; }
+
+float TrajectoryReplay::duration() const {
+  return m_sampleCount > 0 ? (m_sampleCount - 1) * m_timeStep : 0.f;
+}
+
+float TrajectoryReplay::trackLength() const { return m_trackLength; }
+
+TrajectorySample TrajectoryReplay::sample(size_t step) {
+  if (!m_open)
+    return {};
+
+  step = std::min(step, m_sampleCount - 1);
+  auto chunk = step / m_samplesPerChunk;
+  if (chunk != m_decodedChunk && !decode(chunk))
+    return {};
+  return m_decoded[step - chunk * m_samplesPerChunk];
+}
+
+TrajectorySample TrajectoryReplay::sampleAt(float seconds) {
+  if (!m_open || m_timeStep <= 0.f)
+    return sample(0);
+
+  float steps = std::max(seconds, 0.f) / m_timeStep;
+  auto step = size_t(steps);
+  if (step + 1 >= m_sampleCount)
+    return sample(m_sampleCount - 1);
+
+  auto a = sample(step);
+  auto b = sample(step + 1);
+  float t = steps - step;
+
+  // the shorter way around, a lap may end between the two steps
+  float ds = b.s - a.s;
+  if (m_trackLength > 0.f && std::abs(ds) > 0.5f * m_trackLength) {
+    ds -= std::copysign(m_trackLength, ds);
+  }
+
+  TrajectorySample result = a;
+  result.s = a.s + t * ds;
+  if (m_trackLength > 0.f) {
+    result.s = std::fmod(result.s, m_trackLength);
+    if (result.s < 0.f)
+      result.s += m_trackLength;
+  }
+  result.speed = a.speed + t * (b.speed - a.speed);
+  return result;
+}
+
+//
+// private functions
+//
+
+bool TrajectoryReplay::decode(size_t chunkIndex) {
+  auto const &info = m_index[chunkIndex];
+  std::vector<byte_t> bytes(info.byteSize);
+  m_file.clear();
+  m_file.seekg(std::streamoff(info.offset));
+  if (!m_file.read(reinterpret_cast<char *>(bytes.data()), bytes.size()) ||
+      std::uint32_t(utils::fnv1a(bytes.data(), bytes.size())) !=
+          info.checksum) {
+    std::cerr << "Error read trajectory " << m_filePath << ": corrupt chunk "
+              << chunkIndex << '\n';
+    m_open = false;
+    return false;
+  }
+
+  auto first = chunkIndex * m_samplesPerChunk;
+  auto count = std::min(m_samplesPerChunk, m_sampleCount - first);
+  // every sample takes at least two bytes
+  if (count > bytes.size() / 2) {
+    std::cerr << "Error read trajectory " << m_filePath << ": truncated chunk "
+              << chunkIndex << '\n';
+    m_decodedChunk = size_t(-1);
+    m_open = false;
+    return false;
+  }
+  m_decoded.resize(count);
+
+  byte_t const *in = bytes.data();
+  byte_t const *end = in + bytes.size();
+  std::int64_t s = 0, step = 0, speed = 0;
+  for (size_t i = 0; i < count; ++i) {
+    std::uint64_t position, velocity;
+    if (!in || !(in = utils::getVarint(in, end, position)) ||
+        !(in = utils::getVarint(in, end, velocity))) {
+      std::cerr << "Error read trajectory " << m_filePath
+                << ": truncated chunk " << chunkIndex << '\n';
+      m_decodedChunk = size_t(-1);
+      m_open = false;
+      return false;
+    }
+
+    if (i == 0) {
+      s = utils::unZigZag(position);
+      speed = utils::unZigZag(velocity >> 2);
+    } else {
+      step += utils::unZigZag(position);
+      s += step;
+      speed += utils::unZigZag(velocity >> 2);
+    }
+    m_decoded[i] = {float(double(s) / m_positionScale),
+                    float(double(speed) / m_speedScale),
+                    RidePhase(velocity & 3)};
+  }
+
+  m_decodedChunk = chunkIndex;
+  return true;
+}
+
+} // namespace modelling
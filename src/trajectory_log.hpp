@@ -0,0 +1,129 @@
+/**
+  Recording and replay of the ride simulation.
+
+  TrajectoryRecorder appends one TrajectorySample per simulation step to a
+  compact log. Values are stored in fixed point and delta encoded as
+  varints, in chunks of a fixed number of steps listed in an index at the
+  end of the file.
+
+  TrajectoryReplay seeks to any step (or time) by decoding the one chunk
+  that holds it, so a recording can be scrubbed or compared without running
+  the physics again. Replayed values are the recorded ones quantized to
+  1/10000 (of a metre, or metre per second).
+  **/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "binary_io.hpp"
+
+namespace modelling {
+
+enum class RidePhase : std::uint8_t {
+  Coasting = 0,
+  Braking = 1,
+  Lift = 2,
+  Boosting = 3
+};
+
+struct TrajectorySample {
+  float s = 0.f;     // arc length along the track
+  float speed = 0.f; // along the track
+  RidePhase phase = RidePhase::Coasting;
+};
+
+class TrajectoryRecorder {
+public: // interface
+  TrajectoryRecorder(std::string const &filePath, float timeStep,
+                     float trackLength, size_t samplesPerChunk = 1024);
+  ~TrajectoryRecorder();
+
+  TrajectoryRecorder(TrajectoryRecorder const &) = delete;
+  TrajectoryRecorder &operator=(TrajectoryRecorder const &) = delete;
+
+  bool isOpen() const;
+  size_t sampleCount() const;
+
+  void record(TrajectorySample const &sample);
+
+  // writes the last chunk and the index, later samples are ignored
+  void finish();
+
+private: // types
+  struct ChunkInfo {
+    std::uint64_t offset;
+    std::uint32_t byteSize;
+    std::uint32_t checksum;
+  };
+
+private: // functions
+  void flushChunk();
+
+private: // member variables
+  std::ofstream m_file;
+  float m_timeStep;
+  float m_trackLength;
+  size_t m_samplesPerChunk;
+
+  std::vector<ChunkInfo> m_index;
+  std::vector<utils::byte_t> m_chunk;
+  size_t m_chunkSamples = 0;
+  std::uint64_t m_sampleCount = 0;
+  std::uint64_t m_offset = 0;
+
+  // previous fixed-point sample, the deltas are taken against it
+  std::int64_t m_s = 0;
+  std::int64_t m_step = 0;
+  std::int64_t m_speed = 0;
+  bool m_finished = false;
+};
+
+class TrajectoryReplay {
+public: // interface
+  explicit TrajectoryReplay(std::string const &filePath);
+
+  // false once a corrupt chunk was found, samples are then default ones
+  bool isOpen() const;
+  size_t sampleCount() const;
+  float timeStep() const;
+  float duration() const;
+  float trackLength() const;
+
+  // sample of simulation step, clamped to the last one
+  TrajectorySample sample(size_t step);
+
+  // interpolated between the steps around seconds (wrapping around the
+  // track), the phase is the one of the earlier step
+  TrajectorySample sampleAt(float seconds);
+
+private: // types
+  struct ChunkInfo {
+    std::uint64_t offset;
+    std::uint32_t byteSize;
+    std::uint32_t checksum;
+  };
+
+private: // functions
+  bool decode(size_t chunkIndex);
+
+private: // member variables
+  std::ifstream m_file;
+  std::string m_filePath;
+  std::vector<ChunkInfo> m_index;
+  size_t m_samplesPerChunk = 1;
+  size_t m_sampleCount = 0;
+  float m_positionScale = 1.f;
+  float m_speedScale = 1.f;
+  float m_timeStep = 0.f;
+  float m_trackLength = 0.f;
+  bool m_open = false;
+
+  size_t m_decodedChunk = size_t(-1);
+  std::vector<TrajectorySample> m_decoded;
+};
+
+} // namespace modelling
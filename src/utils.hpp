@@ -5,8 +5,11 @@
 
 
 namespace utils {
+	// the samplers take any table with nearestValueTo / nextValueTo, an
+	// ArcLengthTable or a CompressedArcLengthTable
+	template <typename TableT>
 	modelling::vec3f
-	getInterpolatedPoint(const modelling::HermiteCurve &curve, const modelling::ArcLengthTable &arcLengthTable,
+	getInterpolatedPoint(const modelling::HermiteCurve &curve, const TableT &arcLengthTable,
 						 float delta_s, float s) {
 		auto curve_p = curve(arcLengthTable.nearestValueTo(s));
 		auto curve_q = curve(arcLengthTable.nextValueTo(s));
@@ -14,8 +17,9 @@ namespace utils {
 		return curve_p + ((s - index * delta_s) / delta_s) * (curve_q - curve_p);
 	}
 
+	template <typename TableT>
 	modelling::vec3f getNormalOfPoint(modelling::HermiteCurve const &curve,
-									  modelling::ArcLengthTable const &arcLengthTable,
+									  TableT const &arcLengthTable,
 									  float speed,
 									  float arcLength,
 									  float delta_s, float s) {
@@ -34,8 +38,9 @@ namespace utils {
 //		return -glm::normalize(N);
 	}
 
+	template <typename TableT>
 	modelling::vec3f getTangentOfPoint(modelling::HermiteCurve const &curve,
-									   modelling::ArcLengthTable const &arcLengthTable,
+									   TableT const &arcLengthTable,
 									   float arcLength,
 									   float delta_s, float s) {
 		float nextPointS = s + delta_s;
@@ -84,10 +89,12 @@ namespace utils {
 		return getDeltaSpeed(point, maxPoint);
 	}
 
+	// speed of the train at s, see modelling::SpeedTable
+	template <typename TableT>
 	glm::mat4 calculateMatrixOfPoint(
 			modelling::HermiteCurve const &curve,
-			modelling::ArcLengthTable const &arcLengthTable,
-			glm::vec3 maxPoint,
+			TableT const &arcLengthTable,
+			float speed,
 			glm::vec3 point,
 			float arc_length, float delta_s, float s,
 			bool translateWagon=false) {
@@ -95,7 +102,7 @@ namespace utils {
 		auto normal = utils::getNormalOfPoint(
 				curve,
 				arcLengthTable,
-				utils::getEnoughSpeed(point, maxPoint),
+				speed,
 				arc_length,
 				delta_s, s);
 		auto biNormal = glm::normalize(glm::cross(tangent, normal));
@@ -108,4 +115,16 @@ namespace utils {
 		return m;
 	}
 
+	template <typename TableT>
+	glm::mat4 calculateMatrixOfPoint(
+			modelling::HermiteCurve const &curve,
+			TableT const &arcLengthTable,
+			glm::vec3 maxPoint,
+			glm::vec3 point,
+			float arc_length, float delta_s, float s,
+			bool translateWagon=false) {
+		return calculateMatrixOfPoint(curve, arcLengthTable, utils::getEnoughSpeed(point, maxPoint), point,
+									  arc_length, delta_s, s, translateWagon);
+	}
+
 } //end of namespace utils
\ No newline at end of file
@@ -0,0 +1,94 @@
+/**
+  Compares ArcLengthTable against CompressedArcLengthTable:
+  memory, accuracy and the cost of a random nearestValueTo/nextValueTo pair.
+
+  usage: arc_length_bench [track.obj] [lookups]
+  **/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "compressed_arc_length_table.hpp"
+#include "curve_file_io.hpp"
+
+using namespace modelling;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+template <typename Table>
+double lookupNanoseconds(Table const &table, std::vector<float> const &samples,
+                         float &sink) {
+  auto start = clock_type::now();
+  float sum = 0.f;
+  for (auto s : samples) {
+    sum += table.nearestValueTo(s) + table.nextValueTo(s);
+  }
+  auto elapsed = clock_type::now() - start;
+  sink += sum; // keep the loop from being optimized away
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         samples.size();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string trackPath =
+      argc > 1 ? argv[1] : "./models/roller_coaster_1.obj";
+  size_t lookups = argc > 2 ? std::stoul(argv[2]) : 10'000'000;
+
+  auto curve = readHermiteCurveFrom_OBJ_File(trackPath);
+  if (!curve) {
+    std::fprintf(stderr, "Unable to read track %s\n", trackPath.c_str());
+    return 1;
+  }
+
+  float delta_u = 0.00001f;
+  float length = arcLength(*curve, delta_u);
+  std::printf("track %s, arc length %.2f\n", trackPath.c_str(), length);
+  std::printf("%10s %10s %8s %12s %12s %10s %12s %8s %8s\n", "delta s",
+              "entries", "covers", "float B", "packed B", "ratio",
+              "max err (u)", "float ns", "packed ns");
+
+  std::mt19937 rng(42);
+  float sink = 0.f;
+  for (float delta_s : {0.5f, 0.1f, 0.01f, 0.001f}) {
+    // entries are added once a step of u overshoots delta s, so the steps
+    // have to be short next to it or the table stops short of the track's
+    // end. Float u stops advancing below a few ulps of 1, rows that still
+    // fall short are left out rather than measured.
+    float row_delta_u =
+        std::max(std::min(delta_u, delta_s / length / 64), 2.5e-7f);
+    auto table = calculateArcLengthTable(*curve, delta_s, row_delta_u);
+    float coverage = table.length() / length;
+    if (coverage < 0.98f) {
+      std::printf("%10.3f %10zu   covers %.1f%% of the track at delta u %g\n",
+                  delta_s, table.size(), coverage * 100, row_delta_u);
+      continue;
+    }
+    CompressedArcLengthTable packed(table);
+
+    std::uniform_real_distribution<float> dist(0.f, table.length());
+    std::vector<float> samples(lookups);
+    for (auto &s : samples) {
+      s = dist(rng);
+    }
+
+    auto floatBytes = table.size() * sizeof(float);
+    auto floatNs = lookupNanoseconds(table, samples, sink);
+    auto packedNs = lookupNanoseconds(packed, samples, sink);
+
+    std::printf("%10.3f %10zu %7.1f%% %12zu %12zu %10.2f %12.3g %8.2f %8.2f\n",
+                delta_s, table.size(), coverage * 100, floatBytes,
+                packed.memoryBytes(),
+                double(floatBytes) / packed.memoryBytes(), packed.maxError(),
+                floatNs, packedNs);
+  }
+
+  return sink == 0.12345f ? 2 : 0;
+}
@@ -0,0 +1,88 @@
+/**
+  Converts a control point file into a streaming track (see
+  StreamingTrackWriter) without ever holding the whole curve.
+
+  usage: make_streaming_track <control points .txt/.obj> <out.trks> [options]
+    --spacing <m>       arc length between table entries (default 0.1)
+    --delta-u <u>       step of the arc-length walk (default: a quarter of
+                        the spacing over an estimated track length)
+    --chunk <segments>  curve segments per chunk (default 4096)
+
+  Open the result with `a1_base --stream <out.trks>`.
+  **/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "curve_file_io.hpp"
+#include "streaming_track.hpp"
+
+using namespace modelling;
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::fprintf(stderr,
+                 "usage: %s <control points> <out.trks> [--spacing m] "
+                 "[--delta-u u] [--chunk segments]\n",
+                 argv[0]);
+    return 2;
+  }
+  std::string input = argv[1], output = argv[2];
+  float spacing = 0.1f, delta_u = 0.f;
+  size_t segmentsPerChunk = 4096;
+  for (int i = 3; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--spacing") == 0) {
+      spacing = std::stof(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--delta-u") == 0) {
+      delta_u = std::stof(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--chunk") == 0) {
+      segmentsPerChunk = std::stoul(argv[i + 1]);
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  auto count = countControlPoints(input);
+  if (!count || *count < 2) {
+    std::fprintf(stderr, "%s: no track\n", input.c_str());
+    return 2;
+  }
+
+  // the walk has to take several steps per table entry, estimated from the
+  // control polygon (a lower bound on the curve's length)
+  if (delta_u <= 0.f) {
+    double polygon = 0.0;
+    vec3f first{0.f}, previous{0.f};
+    size_t seen = 0;
+    forEachControlPoint(input, [&](HermiteCurve::ControlPoint const &cp) {
+      if (seen++ == 0)
+        first = cp.position;
+      else
+        polygon += glm::length(cp.position - previous);
+      previous = cp.position;
+    });
+    polygon += glm::length(first - previous);
+    delta_u = float(std::min(1e-5, spacing / std::max(polygon, 1e-3) / 4));
+  }
+
+  StreamingTrackWriter writer(output, *count, spacing, delta_u,
+                              segmentsPerChunk);
+  size_t mostResident = 0;
+  forEachControlPoint(input, [&](HermiteCurve::ControlPoint const &cp) {
+    writer.add(cp);
+    mostResident = std::max(mostResident, writer.residentControlPoints());
+  });
+  if (!writer.finish()) {
+    std::fprintf(stderr, "%s: unable to write\n", output.c_str());
+    return 2;
+  }
+
+  std::printf("%s: %zu control points, %.1f m, %zu table entries in %zu "
+              "chunks (at most %zu control points resident)\n",
+              output.c_str(), *count, writer.length(), writer.tableCount(),
+              writer.chunkCount(), mostResident);
+  return 0;
+}
@@ -0,0 +1,245 @@
+/**
+  Batch ride analysis of a catalog of tracks (see analyzeTrack).
+
+  usage: track_analyze [options] <track or directory>...
+    -o <directory>     output directory (default ./analysis)
+    -j <threads>       worker threads (default: all cores)
+    --spacing <m>      arc length between samples (default 0.1)
+    --format csv|bin   per-track profile format (default csv)
+
+  Directories are searched (not recursively) for .obj, .trk and .txt tracks,
+  skipping OBJ meshes.
+  Tracks are analysed in parallel, one per worker at a time. Writes one
+  profile per track plus summary.csv with a row per track.
+
+  Binary profiles (.rcprof) are little endian:
+    char[8]  magic "RCPROF01"
+    u32      column count (7: s, u, height, speed, normal g, lateral g,
+                           clearance)
+    u32      row count
+    f32      spacing
+    f32      length
+    f32[rows * columns], row after row
+  **/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "binary_io.hpp"
+#include "curve_file_io.hpp"
+#include "track_analysis.hpp"
+
+using namespace modelling;
+namespace fs = std::filesystem;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct Result {
+  bool loaded = false;
+  TrackProfileSummary summary;
+  double milliseconds = 0.0;
+};
+
+std::optional<HermiteCurve> readAnyTrack(fs::path const &path) {
+  auto extension = path.extension().string();
+  if (extension == ".trk") {
+    auto track = loadTrackBinary(path.string());
+    if (!track)
+      return std::nullopt;
+    return std::move(track->curve);
+  }
+  if (extension == ".obj")
+    return readHermiteCurveFrom_OBJ_File(path.string());
+  return readHermiteCurveFromFile(path.string());
+}
+
+bool writeCSV(TrackProfile const &profile, fs::path const &path) {
+  std::FILE *file = std::fopen(path.string().c_str(), "w");
+  if (!file)
+    return false;
+  std::fprintf(file, "s,u,height,speed,normal_g,lateral_g,clearance\n");
+  for (size_t i = 0; i < profile.size(); ++i) {
+    std::fprintf(file, "%.3f,%.7f,%.4f,%.4f,%.4f,%.4f,%.4f\n", profile.s[i],
+                 profile.u[i], profile.height[i], profile.speed[i],
+                 profile.normalG[i], profile.lateralG[i],
+                 profile.clearance[i]);
+  }
+  return std::fclose(file) == 0;
+}
+
+bool writeBinary(TrackProfile const &profile, fs::path const &path) {
+  std::vector<std::vector<float> const *> columns = {
+      &profile.s,       &profile.u,        &profile.height,
+      &profile.speed,   &profile.normalG,  &profile.lateralG,
+      &profile.clearance};
+
+  std::vector<utils::byte_t> bytes = {'R', 'C', 'P', 'R', 'O', 'F', '0', '1'};
+  utils::putLE(bytes, std::uint32_t(columns.size()));
+  utils::putLE(bytes, std::uint32_t(profile.size()));
+  utils::putFloat(bytes, profile.spacing);
+  utils::putFloat(bytes, profile.length);
+  bytes.reserve(bytes.size() + profile.size() * columns.size() * 4);
+  for (size_t i = 0; i < profile.size(); ++i) {
+    for (auto const *column : columns) {
+      utils::putFloat(bytes, (*column)[i]);
+    }
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+  return bool(file);
+}
+
+// track OBJs are just a list of vertices, meshes have faces
+bool isMesh(fs::path const &path) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.rfind("f ", 0) == 0)
+      return true;
+  }
+  return false;
+}
+
+bool isTrackFile(fs::path const &path) {
+  auto extension = path.extension().string();
+  if (extension == ".obj")
+    return !isMesh(path);
+  return extension == ".trk" || extension == ".txt";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  fs::path outputDirectory = "analysis";
+  size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+  bool binary = false;
+  TrackAnalysisSettings settings;
+  std::vector<fs::path> tracks;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-o" && hasValue) {
+      outputDirectory = argv[++i];
+    } else if (arg == "-j" && hasValue) {
+      threadCount = std::max<size_t>(1, std::stoul(argv[++i]));
+    } else if (arg == "--spacing" && hasValue) {
+      settings.spacing = std::stof(argv[++i]);
+    } else if (arg == "--format" && hasValue) {
+      binary = std::string(argv[++i]) == "bin";
+    } else if (fs::is_directory(arg)) {
+      std::vector<fs::path> found;
+      for (auto const &entry : fs::directory_iterator(arg)) {
+        if (entry.is_regular_file() && isTrackFile(entry.path())) {
+          found.push_back(entry.path());
+        }
+      }
+      std::sort(std::begin(found), std::end(found));
+      tracks.insert(std::end(tracks), std::begin(found), std::end(found));
+    } else if (fs::is_regular_file(arg)) {
+      tracks.emplace_back(arg);
+    } else {
+      std::fprintf(stderr, "Unknown argument or missing file %s\n",
+                   arg.c_str());
+      return 1;
+    }
+  }
+  if (tracks.empty()) {
+    std::fprintf(stderr,
+                 "usage: %s [-o dir] [-j threads] [--spacing m] "
+                 "[--format csv|bin] <track or directory>...\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::error_code error;
+  fs::create_directories(outputDirectory, error);
+  threadCount = std::min(threadCount, tracks.size());
+
+  // workers take the next track until none are left, results keep the
+  // order of the input
+  std::vector<Result> results(tracks.size());
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> samples{0};
+  auto worker = [&]() {
+    for (size_t i = next++; i < tracks.size(); i = next++) {
+      auto start = clock_type::now();
+      auto curve = readAnyTrack(tracks[i]);
+      if (!curve || curve->controlPoints().empty())
+        continue;
+
+      auto profile = analyzeTrack(*curve, settings);
+      auto stem = tracks[i].stem().string();
+      auto path = outputDirectory / (stem + (binary ? ".rcprof" : ".csv"));
+      if (!(binary ? writeBinary(profile, path) : writeCSV(profile, path))) {
+        std::fprintf(stderr, "Unable to write %s\n", path.string().c_str());
+      }
+
+      results[i].loaded = true;
+      results[i].summary = summarize(profile);
+      results[i].milliseconds = std::chrono::duration<double, std::milli>(
+                                    clock_type::now() - start)
+                                    .count();
+      samples += profile.size();
+    }
+  };
+
+  auto start = clock_type::now();
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threadCount; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : workers) {
+    thread.join();
+  }
+  double seconds =
+      std::chrono::duration<double>(clock_type::now() - start).count();
+
+  auto summaryPath = outputDirectory / "summary.csv";
+  std::FILE *summary = std::fopen(summaryPath.string().c_str(), "w");
+  if (!summary) {
+    std::fprintf(stderr, "Unable to write %s\n", summaryPath.string().c_str());
+    return 1;
+  }
+  std::fprintf(summary,
+               "track,length,samples,min_height,max_height,max_speed,"
+               "min_normal_g,max_normal_g,max_lateral_g,min_clearance,"
+               "min_clearance_s,milliseconds\n");
+  size_t failed = 0;
+  for (size_t i = 0; i < tracks.size(); ++i) {
+    auto const &r = results[i];
+    if (!r.loaded) {
+      std::fprintf(stderr, "Unable to read track %s\n",
+                   tracks[i].string().c_str());
+      ++failed;
+      continue;
+    }
+    auto const &s = r.summary;
+    std::fprintf(summary,
+                 "%s,%.3f,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f\n",
+                 tracks[i].string().c_str(), s.length, s.samples, s.minHeight,
+                 s.maxHeight, s.maxSpeed, s.minNormalG, s.maxNormalG,
+                 s.maxLateralG, s.minClearance, s.minClearanceS,
+                 r.milliseconds);
+  }
+  std::fclose(summary);
+
+  std::printf("%zu tracks (%zu failed), %zu samples in %.2f s on %zu "
+              "threads, %.0f samples/s\n",
+              tracks.size(), failed, samples.load(), seconds, threadCount,
+              samples / std::max(seconds, 1e-9));
+  std::printf("wrote %s\n", summaryPath.string().c_str());
+  return failed > 0 ? 1 : 0;
+}
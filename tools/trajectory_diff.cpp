@@ -0,0 +1,107 @@
+/**
+  Compares two ride recordings step by step (see TrajectoryRecorder) and
+  reports where they diverge.
+
+  usage: trajectory_diff a.rctraj b.rctraj [tolerance]
+
+  Exits with 0 when every step agrees within tolerance (default 1e-3, in
+  metres and metres per second), 1 when they diverge and 2 when a file
+  cannot be read.
+  **/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include "trajectory_log.hpp"
+
+using namespace modelling;
+
+namespace {
+
+// distance along a closed track of length trackLength
+float trackDistance(float a, float b, float trackLength) {
+  float d = std::abs(a - b);
+  return trackLength > 0.f ? std::min(d, std::abs(trackLength - d)) : d;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::fprintf(stderr, "usage: %s a.rctraj b.rctraj [tolerance]\n",
+                 argv[0]);
+    return 2;
+  }
+  float tolerance = argc > 3 ? std::stof(argv[3]) : 1e-3f;
+
+  TrajectoryReplay a(argv[1]);
+  TrajectoryReplay b(argv[2]);
+  if (!a.isOpen() || !b.isOpen())
+    return 2;
+
+  std::printf("%s: %zu steps of %.4f s\n", argv[1], a.sampleCount(),
+              a.timeStep());
+  std::printf("%s: %zu steps of %.4f s\n", argv[2], b.sampleCount(),
+              b.timeStep());
+  bool diverged = a.sampleCount() != b.sampleCount();
+  if (a.timeStep() != b.timeStep()) {
+    std::printf("time steps differ\n");
+    diverged = true;
+  }
+
+  auto steps = std::min(a.sampleCount(), b.sampleCount());
+  size_t firstDivergence = steps;
+  float maxPosition = 0.f, maxSpeed = 0.f;
+  size_t maxPositionStep = 0, maxSpeedStep = 0, phaseMismatches = 0;
+  double sumPosition = 0.0;
+  for (size_t i = 0; i < steps; ++i) {
+    auto sa = a.sample(i);
+    auto sb = b.sample(i);
+    float position = trackDistance(sa.s, sb.s, a.trackLength());
+    float speed = std::abs(sa.speed - sb.speed);
+    sumPosition += double(position) * position;
+
+    if (position > maxPosition) {
+      maxPosition = position;
+      maxPositionStep = i;
+    }
+    if (speed > maxSpeed) {
+      maxSpeed = speed;
+      maxSpeedStep = i;
+    }
+    if (sa.phase != sb.phase) {
+      ++phaseMismatches;
+    }
+    if (firstDivergence == steps &&
+        (position > tolerance || speed > tolerance || sa.phase != sb.phase)) {
+      firstDivergence = i;
+    }
+  }
+
+  if (!a.isOpen() || !b.isOpen())
+    return 2;
+
+  std::printf("compared %zu steps (tolerance %g)\n", steps, tolerance);
+  std::printf("  max position difference %.6f at step %zu\n", maxPosition,
+              maxPositionStep);
+  std::printf("  max speed difference    %.6f at step %zu\n", maxSpeed,
+              maxSpeedStep);
+  std::printf("  rms position difference %.6f\n",
+              steps > 0 ? std::sqrt(sumPosition / steps) : 0.0);
+  std::printf("  phase mismatches        %zu\n", phaseMismatches);
+
+  if (firstDivergence < steps) {
+    auto sa = a.sample(firstDivergence);
+    auto sb = b.sample(firstDivergence);
+    std::printf("first divergence at step %zu (%.4f s): s %.4f vs %.4f, "
+                "speed %.4f vs %.4f, phase %d vs %d\n",
+                firstDivergence, firstDivergence * a.timeStep(), sa.s, sb.s,
+                sa.speed, sb.speed, int(sa.phase), int(sb.phase));
+    diverged = true;
+  }
+
+  std::printf(diverged ? "recordings differ\n" : "recordings match\n");
+  return diverged ? 1 : 0;
+}